@@ -0,0 +1,79 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "../transport-catalogue/json.h"
+
+namespace {
+    // Массив чисел всех видов, которые разбирает LoadNumber: целые, отрицательные,
+    // дробные и с экспонентой, включая целые, не помещающиеся в int
+    std::string GenerateNumbers(size_t count) {
+        std::string numbers = "[";
+        unsigned state = 12345;
+        for (size_t i = 0; i < count; ++i) {
+            state = state * 1103515245u + 12345u;
+            const unsigned value = state >> 8;
+            if (i > 0) {
+                numbers += ',';
+            }
+            switch (i % 5) {
+            case 0:
+                numbers += std::to_string(value % 100000);
+                break;
+            case 1:
+                numbers += '-' + std::to_string(value % 1000);
+                break;
+            case 2:
+                numbers += std::to_string(value % 1000) + '.' + std::to_string(value % 1000000);
+                break;
+            case 3:
+                numbers += std::to_string(value % 10) + '.' + std::to_string(value % 100) + "e-" +
+                           std::to_string(value % 20);
+                break;
+            default:
+                numbers += std::to_string(value) + std::to_string(value);
+                break;
+            }
+        }
+        numbers += ']';
+        return numbers;
+    }
+
+    void Measure(std::string_view name, std::string_view json_text, int iterations) {
+        size_t root_size = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            const json::Document document = json::Load(json_text);
+            root_size += document.GetRoot().IsArray() ? document.GetRoot().AsArray().size()
+                                                      : document.GetRoot().AsDict().size();
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << name << ": " << iterations << " iterations, " << json_text.size() << " bytes each, "
+                  << elapsed.count() * 1000 / iterations << " ms per parse, "
+                  << static_cast<double>(json_text.size()) * iterations / elapsed.count() / (1 << 20) << " MB/s"
+                  << " (" << root_size / iterations << " root elements)" << std::endl;
+    }
+}
+
+// Замер скорости разбора JSON: входной документ целиком и массив чисел.
+// Использование: json_parse_benchmark [input.json] [число повторов]
+int main(int argc, char* argv[]) {
+    const std::string input_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_INPUT;
+    const int iterations = argc > 2 ? std::stoi(argv[2]) : 100;
+
+    std::ifstream input(input_path);
+    if (!input) {
+        std::cerr << "cannot open " << input_path << std::endl;
+        return 1;
+    }
+    std::ostringstream input_text;
+    input_text << input.rdbuf();
+
+    Measure("document", input_text.str(), iterations);
+    Measure("numbers", GenerateNumbers(200'000), iterations);
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "../transport-catalogue/json_reader.h"
+#include "../transport-catalogue/output_buffer.h"
+#include "../transport-catalogue/request_handler.h"
+#include "../transport-catalogue/transport_catalogue.h"
+
+// Замер пропускной способности отрисовки карты.
+// Использование: map_render_benchmark [input.json] [число повторов]
+int main(int argc, char* argv[]) {
+    const std::string input_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_INPUT;
+    const int iterations = argc > 2 ? std::stoi(argv[2]) : 200;
+
+    std::ifstream input(input_path);
+    if (!input) {
+        std::cerr << "cannot open " << input_path << std::endl;
+        return 1;
+    }
+
+    transport::Catalogue catalogue;
+    std::ostringstream unused_output;
+    requesthandler::RequestHandler handler(catalogue, unused_output);
+    jsonreader::JSONReader reader(catalogue, handler);
+    reader.ReadBaseInput(input);
+    const std::shared_ptr<const renderer::MapRenderer> map_renderer = reader.GetMapRenderer();
+
+    size_t total_bytes = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        io::OutputBuffer buffer;
+        map_renderer->Render(buffer);
+        total_bytes += buffer.View().size();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "map render: " << iterations << " iterations, " << total_bytes / iterations << " bytes each, "
+              << elapsed.count() * 1000 / iterations << " ms per render, "
+              << total_bytes / elapsed.count() / (1 << 20) << " MB/s" << std::endl;
+    return 0;
+}
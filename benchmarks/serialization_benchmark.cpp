@@ -0,0 +1,147 @@
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+#include "../transport-catalogue/json.h"
+#include "../transport-catalogue/json_writer.h"
+#include "../transport-catalogue/output_buffer.h"
+#include "../transport-catalogue/svg.h"
+
+namespace {
+    // Поток, который только считает выведенные байты: замер не зависит от скорости приёмника
+    class CountingBuffer : public std::streambuf {
+    public:
+        size_t GetCount() const {
+            return count_;
+        }
+
+    protected:
+        int_type overflow(int_type c) override {
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                ++count_;
+            }
+            return traits_type::not_eof(c);
+        }
+
+        std::streamsize xsputn(const char*, std::streamsize count) override {
+            count_ += static_cast<size_t>(count);
+            return count;
+        }
+
+    private:
+        size_t count_ = 0;
+    };
+
+    void Measure(std::string_view name, int iterations, const std::function<void(std::ostream&)>& serialize) {
+        CountingBuffer counter;
+        std::ostream output(&counter);
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            serialize(output);
+        }
+        output.flush();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << name << ": " << iterations << " iterations, " << counter.GetCount() / iterations
+                  << " bytes each, " << elapsed.count() * 1000 / iterations << " ms per document, "
+                  << static_cast<double>(counter.GetCount()) / elapsed.count() / (1 << 20) << " MB/s" << std::endl;
+    }
+
+    void WriteNode(json::Writer& writer, const json::Node& node) {
+        if (node.IsNull()) {
+            writer.Value(nullptr);
+        }
+        else if (node.IsBool()) {
+            writer.Value(node.AsBool());
+        }
+        else if (node.IsInt()) {
+            writer.Value(node.AsInt());
+        }
+        else if (node.IsPureDouble()) {
+            writer.Value(node.AsDouble());
+        }
+        else if (node.IsString()) {
+            writer.Value(node.AsString());
+        }
+        else if (node.IsArray()) {
+            writer.StartArray();
+            for (const json::Node& element : node.AsArray()) {
+                WriteNode(writer, element);
+            }
+            writer.EndArray();
+        }
+        else {
+            writer.StartDict();
+            for (const auto& [key, value] : node.AsDict()) {
+                writer.Key(key);
+                WriteNode(writer, value);
+            }
+            writer.EndDict();
+        }
+    }
+
+    // Документ из object_count кругов, ломаных и надписей в равных долях
+    svg::Document GenerateSvg(size_t object_count) {
+        svg::Document document;
+        for (size_t i = 0; i < object_count; ++i) {
+            const svg::Point point{static_cast<double>(i % 1000) * 0.731, static_cast<double>(i / 1000) * 1.377};
+            switch (i % 3) {
+            case 0:
+                document.Add(svg::Circle().SetCenter(point).SetRadius(5.).SetFillColor("white"));
+                break;
+            case 1:
+                document.Add(svg::Polyline()
+                                 .AddPoint(point).AddPoint({point.x + 10., point.y + 3.}).AddPoint({point.x, point.y + 7.})
+                                 .SetStrokeColor("green").SetFillColor(svg::NoneColor).SetStrokeWidth(14.)
+                                 .SetStrokeLineCap(svg::StrokeLineCap::ROUND)
+                                 .SetStrokeLineJoin(svg::StrokeLineJoin::ROUND));
+                break;
+            default:
+                document.Add(svg::Text().SetPosition(point).SetOffset({7., -3.}).SetFontSize(20)
+                                 .SetFontFamily("Verdana").SetData("Stop " + std::to_string(i)).SetFillColor("black"));
+                break;
+            }
+        }
+        return document;
+    }
+}
+
+// Замер скорости вывода: json::Print и json::Writer для входного документа, svg::Document::Render.
+// Использование: serialization_benchmark [input.json] [число повторов]
+int main(int argc, char* argv[]) {
+    const std::string input_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_INPUT;
+    const int iterations = argc > 2 ? std::stoi(argv[2]) : 100;
+
+    std::ifstream input(input_path);
+    if (!input) {
+        std::cerr << "cannot open " << input_path << std::endl;
+        return 1;
+    }
+    const json::Document document = json::Load(input);
+
+    Measure("json::Print", iterations, [&document](std::ostream& output) {
+        json::Print(document, output);
+    });
+    Measure("json::Writer", iterations, [&document](std::ostream& output) {
+        io::OutputBuffer buffer(output);
+        json::Writer writer(buffer);
+        WriteNode(writer, document.GetRoot());
+        writer.Flush();
+    });
+
+    // Меньший документ выводится одним потоком, больший - частями параллельно
+    for (const size_t object_count : {3'000, 60'000}) {
+        const svg::Document svg_document = GenerateSvg(object_count);
+        Measure("svg::Document::Render, " + std::to_string(object_count) + " objects", iterations,
+                [&svg_document](std::ostream& output) {
+                    io::OutputBuffer buffer(output);
+                    svg_document.Render(buffer);
+                    buffer.Flush();
+                });
+    }
+    return 0;
+}
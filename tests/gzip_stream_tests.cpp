@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <ostream>
+#include <string>
+
+#include <zlib.h>
+
+#include "../transport-catalogue/gzip_stream.h"
+#include "../transport-catalogue/output_buffer.h"
+
+using namespace std::literals;
+
+namespace {
+    std::string DecodeBase64(std::string_view text) {
+        const std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"sv;
+        std::string result;
+        unsigned value = 0;
+        int bits = 0;
+        for (const char c : text) {
+            if (c == '=') {
+                break;
+            }
+            value = (value << 6) | static_cast<unsigned>(alphabet.find(c));
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                result.push_back(static_cast<char>((value >> bits) & 0xFF));
+            }
+        }
+        return result;
+    }
+
+    std::string Gunzip(const std::string& compressed) {
+        z_stream stream{};
+        inflateInit2(&stream, 15 + 16);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+        stream.avail_in = static_cast<uInt>(compressed.size());
+        std::string result;
+        char chunk[4096];
+        int status = Z_OK;
+        while (status == Z_OK) {
+            stream.next_out = reinterpret_cast<Bytef*>(chunk);
+            stream.avail_out = sizeof(chunk);
+            status = inflate(&stream, Z_NO_FLUSH);
+            result.append(chunk, sizeof(chunk) - stream.avail_out);
+        }
+        inflateEnd(&stream);
+        EXPECT_EQ(status, Z_STREAM_END);
+        return result;
+    }
+}
+
+TEST(GzipStreamTest, RoundTripsThroughBase64) {
+    std::string source;
+    for (int i = 0; i < 20000; ++i) {
+        source += "<circle cx=\""s + std::to_string(i) + "\" r=\"5\"/>\n"s;
+    }
+
+    std::string encoded;
+    io::GzipBase64Streambuf gzip(encoded);
+    {
+        std::ostream stream(&gzip);
+        io::OutputBuffer buffer(stream, 1000);
+        buffer << source;
+    }
+    gzip.Finish();
+
+    EXPECT_EQ(encoded.size() % 4, 0u);
+    EXPECT_LT(encoded.size(), source.size() / 4);
+    EXPECT_EQ(Gunzip(DecodeBase64(encoded)), source);
+}
+
+TEST(GzipStreamTest, EncodesEmptyInput) {
+    std::string encoded;
+    io::GzipBase64Streambuf gzip(encoded);
+    gzip.Finish();
+    EXPECT_EQ(Gunzip(DecodeBase64(encoded)), ""s);
+}
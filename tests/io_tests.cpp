@@ -3,16 +3,36 @@
 #include "../transport-catalogue/transport_catalogue.h"
 #include "../transport-catalogue/request_handler.h"
 #include "../transport-catalogue/json_reader.h"
+#include "../transport-catalogue/server.h"
 
 class IOTest : public testing::Test {
 protected:
-    IOTest() : handler_(catalogue_), reader_(catalogue_, handler_) {}
+    IOTest() : handler_(catalogue_, output_), reader_(catalogue_, handler_) {}
 
     void SetUp() override {}
 
     void TearDown() override {}
 
+    void ReadSampleBase() {
+        std::istringstream base(R"({
+            "base_requests": [
+                {"type": "Stop", "name": "A", "latitude": 55.6, "longitude": 37.2, "road_distances": {"B": 1000}},
+                {"type": "Stop", "name": "B", "latitude": 55.7, "longitude": 37.3, "road_distances": {}},
+                {"type": "Bus", "name": "1", "stops": ["A", "B"], "is_roundtrip": false}
+            ],
+            "render_settings": {
+                "width": 200, "height": 200, "padding": 30, "stop_radius": 5, "line_width": 14,
+                "bus_label_font_size": 20, "bus_label_offset": [7, 15], "stop_label_font_size": 20,
+                "stop_label_offset": [7, -3], "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3,
+                "color_palette": ["green"]
+            },
+            "routing_settings": {"bus_wait_time": 6, "bus_velocity": 40}
+        })");
+        reader_.ReadBaseInput(base);
+    }
+
     transport::Catalogue catalogue_;
+    std::ostringstream output_;
     requesthandler::RequestHandler handler_;
     jsonreader::JSONReader reader_;
 };
@@ -21,3 +41,300 @@ TEST_F(IOTest, TestingTests) {
     std::stringstream input;
     std::getenv("PROJECT_DIR");
 }
+
+TEST_F(IOTest, ServesNewlineDelimitedRequests) {
+    ReadSampleBase();
+
+    std::istringstream requests("{\"id\": 1, \"type\": \"Stop\", \"name\": \"A\"}\n"
+                                "\n"
+                                "{\"id\": 2, \"type\": \"Bus\", \"name\": \"2\"}\n"
+                                "{\"id\": 3, \"type\": \"Unknown\"}\n"
+                                "not json\n");
+    std::ostringstream responses;
+    server::ServeStream(reader_, requests, responses);
+
+    EXPECT_EQ(responses.str(),
+              "{\"buses\":[\"1\"],\"request_id\":1}\n"
+              "{\"error_message\":\"not found\",\"request_id\":2}\n"
+              "{\"error_message\":\"unknown request type\",\"request_id\":3}\n"
+              "{\"error_message\":\"Failed to parse 'not' as null\"}\n");
+}
+
+TEST_F(IOTest, ReportsMemoryBySubsystem) {
+    ReadSampleBase();
+
+    std::istringstream requests("{\"id\": 1, \"type\": \"Memory\"}\n");
+    std::ostringstream responses;
+    server::ServeStream(reader_, requests, responses);
+
+    // Счётчики зависят от TC_MEMORY_REPORT, поэтому проверяется только структура ответа
+    const json::Document response = json::Load(responses.str());
+    const json::Dict& response_dict = response.GetRoot().AsDict();
+    EXPECT_EQ(response_dict.at("request_id").AsInt(), 1);
+    EXPECT_EQ(response_dict.at("enabled").AsBool(), memory::IsTrackingEnabled());
+    const json::Dict& subsystems = response_dict.at("subsystems").AsDict();
+    for (const char* subsystem : {"catalogue", "handler", "json", "other", "renderer", "router"}) {
+        ASSERT_TRUE(subsystems.count(subsystem)) << subsystem;
+        const json::Dict& stats = subsystems.at(subsystem).AsDict();
+        EXPECT_GE(stats.at("peak_bytes").AsInt(), stats.at("current_bytes").AsInt());
+        EXPECT_GE(stats.at("allocations").AsInt(), 0);
+    }
+}
+
+TEST_F(IOTest, ReportsEngineStats) {
+    ReadSampleBase();
+
+    std::istringstream requests("{\"id\": 1, \"type\": \"Stats\"}\n"
+                                "{\"id\": 2, \"type\": \"Route\", \"from\": \"A\", \"to\": \"B\"}\n"
+                                "{\"id\": 3, \"type\": \"Route\", \"from\": \"A\", \"to\": \"B\"}\n"
+                                "{\"id\": 4, \"type\": \"Stats\"}\n");
+    std::ostringstream responses;
+    server::ServeStream(reader_, requests, responses);
+
+    std::istringstream response_lines(responses.str());
+    std::string line;
+    std::vector<json::Document> stats;
+    while (std::getline(response_lines, line)) {
+        json::Document response = json::Load(line);
+        if (response.GetRoot().AsDict().count("catalogue")) {
+            stats.push_back(std::move(response));
+        }
+    }
+    ASSERT_EQ(stats.size(), 2u);
+
+    // Запрос статистики не строит маршрутизатор
+    const json::Dict& before = stats[0].GetRoot().AsDict();
+    EXPECT_FALSE(before.at("router").AsDict().at("built").AsBool());
+    EXPECT_EQ(before.at("requests").AsDict().at("Route").AsDict().at("count").AsInt(), 0);
+
+    const json::Dict& after = stats[1].GetRoot().AsDict();
+    EXPECT_EQ(after.at("request_id").AsInt(), 4);
+    const json::Dict& catalogue = after.at("catalogue").AsDict();
+    EXPECT_EQ(catalogue.at("stops").AsInt(), 2);
+    EXPECT_EQ(catalogue.at("buses").AsInt(), 1);
+    EXPECT_EQ(catalogue.at("distances").AsInt(), 1);
+    EXPECT_EQ(after.at("requests").AsDict().at("Route").AsDict().at("count").AsInt(), 2);
+    EXPECT_EQ(after.at("requests").AsDict().at("Stats").AsDict().at("count").AsInt(), 1);
+    const json::Dict& router = after.at("router").AsDict();
+    EXPECT_TRUE(router.at("built").AsBool());
+    EXPECT_EQ(router.at("vertices").AsInt(), 4);
+    EXPECT_GT(router.at("routes_table_bytes").AsInt(), 0);
+    // Второй Route отвечен из кэша ответов и маршрутизатор не спрашивает
+    EXPECT_EQ(after.at("search").AsDict().at("route_queries").AsInt(), 1);
+    EXPECT_EQ(after.at("response_cache").AsDict().at("hits").AsInt(), 1);
+}
+
+TEST_F(IOTest, KeepsReplacedRouterAndMapAlive) {
+    ReadSampleBase();
+    const std::shared_ptr<const transport::Router> router = reader_.GetRouter();
+    const std::shared_ptr<const renderer::MapRenderer> map_renderer = reader_.GetMapRenderer();
+
+    // После изменения справочника карта и маршрутизатор перестраиваются, а прежние остаются рабочими
+    catalogue_.AddStop(transport::Stop{"C", {55.8, 37.4}});
+    EXPECT_NE(reader_.GetRouter(), router);
+    EXPECT_NE(reader_.GetMapRenderer(), map_renderer);
+    EXPECT_TRUE(router->PlotRoute("A", "B").has_value());
+    io::OutputBuffer buffer;
+    map_renderer->Render(buffer);
+    EXPECT_NE(buffer.View().find("<svg"), std::string_view::npos);
+}
+
+TEST_F(IOTest, SharesResponseCacheAcrossConnections) {
+    ReadSampleBase();
+
+    for (int connection = 0; connection < 2; ++connection) {
+        std::istringstream requests("{\"id\": 1, \"type\": \"Stop\", \"name\": \"A\"}\n");
+        std::ostringstream responses;
+        server::ServeStream(reader_, requests, responses);
+        EXPECT_EQ(responses.str(), "{\"buses\":[\"1\"],\"request_id\":1}\n");
+    }
+    EXPECT_EQ(handler_.GetResponseCacheStats().hits, 1u);
+    EXPECT_EQ(handler_.GetResponseCacheStats().misses, 1u);
+
+    // Новые настройки маршрутизации сбрасывают общий кэш
+    std::istringstream settings(R"({"base_requests": [], "render_settings": {
+        "width": 200, "height": 200, "padding": 30, "stop_radius": 5, "line_width": 14,
+        "bus_label_font_size": 20, "bus_label_offset": [7, 15], "stop_label_font_size": 20,
+        "stop_label_offset": [7, -3], "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3,
+        "color_palette": ["green"]}, "routing_settings": {"bus_wait_time": 2, "bus_velocity": 30}})");
+    reader_.ReadBaseInput(settings);
+    EXPECT_EQ(handler_.GetResponseCacheStats().entries, 0u);
+}
+
+TEST_F(IOTest, ServesMapTiles) {
+    ReadSampleBase();
+
+    std::istringstream requests("{\"id\": 1, \"type\": \"MapTile\", \"zoom\": 1, \"x\": 0, \"y\": 1}\n"
+                                "{\"id\": 2, \"type\": \"MapTile\", \"zoom\": 1, \"x\": 2, \"y\": 0}\n");
+    std::ostringstream responses;
+    server::ServeStream(reader_, requests, responses);
+
+    std::string first_line;
+    std::string second_line;
+    std::istringstream lines(responses.str());
+    std::getline(lines, first_line);
+    std::getline(lines, second_line);
+
+    // Остановка A лежит в левой нижней четверти карты, B - в правой верхней
+    EXPECT_NE(first_line.find(R"(viewBox=\"0 100 100 100\")"), std::string::npos);
+    EXPECT_NE(first_line.find(">A</text>"), std::string::npos);
+    EXPECT_EQ(first_line.find(">B</text>"), std::string::npos);
+    EXPECT_NE(first_line.find("<polyline"), std::string::npos);
+    EXPECT_EQ(second_line, "{\"error_message\":\"not found\",\"request_id\":2}");
+}
+
+TEST_F(IOTest, AssemblesSeparatelyPreparedResponses) {
+    ReadSampleBase();
+
+    for (const requesthandler::OutputMode mode : {requesthandler::OutputMode::DOCUMENT,
+                                                  requesthandler::OutputMode::LINES}) {
+        const auto prepare = [](requesthandler::RequestHandler& handler, int request_id) {
+            switch (request_id) {
+            case 1:
+                handler.PrepareStop(request_id, "A");
+                break;
+            case 2:
+                handler.PrepareBus(request_id, "1");
+                break;
+            default:
+                handler.PrepareError(request_id, "not found");
+            }
+        };
+
+        std::ostringstream expected;
+        requesthandler::RequestHandler direct_handler(catalogue_, expected, mode);
+        for (int request_id = 1; request_id <= 3; ++request_id) {
+            prepare(direct_handler, request_id);
+        }
+        direct_handler.Finish();
+
+        std::ostringstream assembled;
+        requesthandler::RequestHandler assembling_handler(catalogue_, assembled, mode);
+        io::OutputBuffer fragment;
+        requesthandler::RequestHandler fragment_handler(assembling_handler, fragment);
+        for (int request_id = 1; request_id <= 3; ++request_id) {
+            prepare(fragment_handler, request_id);
+            assembling_handler.PrepareFragment(fragment.Take());
+        }
+        assembling_handler.Finish();
+
+        EXPECT_EQ(assembled.str(), expected.str());
+    }
+}
+
+TEST_F(IOTest, MemoizesRepeatedRequests) {
+    ReadSampleBase();
+
+    const json::Document requests = json::Load(R"([
+        {"id": 1, "type": "Stop", "name": "A"},
+        {"id": 2, "type": "Route", "from": "A", "to": "B"},
+        {"id": 3, "type": "Bus", "name": "2"},
+        {"id": 40, "type": "Stop", "name": "A"},
+        {"id": 50, "type": "Route", "from": "A", "to": "B"},
+        {"id": 60, "type": "Bus", "name": "2"}
+    ])");
+    for (const json::Node& request : requests.GetRoot().AsArray()) {
+        ASSERT_TRUE(reader_.ProcessStatRequest(request.AsDict(), handler_));
+    }
+    handler_.Finish();
+
+    const json::Document responses = json::Load(output_.str());
+    const json::Array& array = responses.GetRoot().AsArray();
+    ASSERT_EQ(array.size(), 6u);
+    for (size_t i = 0; i < 3; ++i) {
+        json::Dict repeated = array[i + 3].AsDict();
+        EXPECT_EQ(repeated.at("request_id"), json::Node(static_cast<int>(i + 4) * 10));
+        repeated["request_id"] = array[i].AsDict().at("request_id");
+        EXPECT_EQ(json::Node(repeated), array[i]);
+    }
+
+    const requesthandler::ResponseCache::Stats stats = handler_.GetResponseCacheStats();
+    EXPECT_EQ(stats.hits, 3u);
+    EXPECT_EQ(stats.misses, 3u);
+    EXPECT_EQ(stats.entries, 3u);
+
+    // Изменение справочника делает запомненные ответы недействительными
+    catalogue_.AddStop(transport::Stop{"C", {55.8, 37.4}});
+    ASSERT_TRUE(reader_.ProcessStatRequest(requests.GetRoot().AsArray()[0].AsDict(), handler_));
+    EXPECT_EQ(handler_.GetResponseCacheStats().misses, 4u);
+}
+
+TEST(StatRequestTest, DecodesRequestFields) {
+    using jsonreader::JSONReader;
+    using jsonreader::StatRequest;
+
+    const json::Document route = json::Load(R"({"to": "B", "type": "Route", "id": 7, "from": "A", "deadline_ms": 5})");
+    const StatRequest decoded_route = JSONReader::DecodeStatRequest(route.GetRoot().AsDict());
+    EXPECT_EQ(decoded_route.type, StatRequest::Type::ROUTE);
+    EXPECT_EQ(decoded_route.id, 7);
+    EXPECT_EQ(decoded_route.name, "A");
+    EXPECT_EQ(decoded_route.to, "B");
+    EXPECT_EQ(decoded_route.deadline_ms, 5);
+
+    const json::Document tile = json::Load(R"({"id": 1, "type": "MapTile", "zoom": 2, "x": 3, "y": 1})");
+    const StatRequest decoded_tile = JSONReader::DecodeStatRequest(tile.GetRoot().AsDict());
+    EXPECT_EQ(decoded_tile.type, StatRequest::Type::MAP_TILE);
+    EXPECT_EQ(decoded_tile.zoom, 2);
+    EXPECT_EQ(decoded_tile.x, 3);
+    EXPECT_EQ(decoded_tile.y, 1);
+
+    // Поля запроса неизвестного типа не проверяются
+    const json::Document unknown = json::Load(R"({"type": "Unknown"})");
+    EXPECT_EQ(JSONReader::DecodeStatRequest(unknown.GetRoot().AsDict()).type, StatRequest::Type::UNKNOWN);
+
+    const json::Document no_name = json::Load(R"({"id": 1, "type": "Stop"})");
+    EXPECT_THROW(JSONReader::DecodeStatRequest(no_name.GetRoot().AsDict()), std::out_of_range);
+}
+
+TEST(PipelineTest, MatchesBatchOutput) {
+    std::string input = R"({
+        "base_requests": [
+            {"type": "Stop", "name": "A", "latitude": 55.6, "longitude": 37.2, "road_distances": {"B": 1000}},
+            {"type": "Stop", "name": "B", "latitude": 55.7, "longitude": 37.3, "road_distances": {}},
+            {"type": "Bus", "name": "1", "stops": ["A", "B"], "is_roundtrip": false}
+        ],
+        "stat_requests": [)";
+    // Запросов больше, чем помещается в один пакет конвейера
+    for (int id = 1; id <= 200; ++id) {
+        input += id == 1 ? "" : ",";
+        switch (id % 4) {
+        case 0:
+            input += R"({"id": )" + std::to_string(id) + R"(, "type": "Stop", "name": "A"})";
+            break;
+        case 1:
+            input += R"({"id": )" + std::to_string(id) + R"(, "type": "Bus", "name": "1"})";
+            break;
+        case 2:
+            input += R"({"id": )" + std::to_string(id) + R"(, "type": "Route", "from": "B", "to": "A"})";
+            break;
+        default:
+            input += R"({"id": )" + std::to_string(id) + R"(, "type": "Unknown"})";
+        }
+    }
+    input += R"(],
+        "render_settings": {
+            "width": 200, "height": 200, "padding": 30, "stop_radius": 5, "line_width": 14,
+            "bus_label_font_size": 20, "bus_label_offset": [7, 15], "stop_label_font_size": 20,
+            "stop_label_offset": [7, -3], "underlayer_color": [255, 255, 255, 0.85], "underlayer_width": 3,
+            "color_palette": ["green"]
+        },
+        "routing_settings": {"bus_wait_time": 6, "bus_velocity": 40}
+    })";
+
+    const auto run = [&input](bool pipelined) {
+        transport::Catalogue catalogue;
+        std::ostringstream output;
+        requesthandler::RequestHandler handler(catalogue, output);
+        jsonreader::JSONReader reader(catalogue, handler);
+        std::istringstream input_stream(input);
+        if (pipelined) {
+            EXPECT_EQ(reader.ReadInputPipelined(input_stream).request_count, 200u);
+        }
+        else {
+            reader.ReadInput(input_stream);
+        }
+        handler.Finish();
+        return output.str();
+    };
+    EXPECT_EQ(run(true), run(false));
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "../transport-catalogue/json.h"
+#include "../transport-catalogue/json_builder.h"
+#include "../transport-catalogue/json_writer.h"
+#include "../transport-catalogue/output_buffer.h"
+
+using namespace std::literals;
+
+namespace {
+    json::Node LoadJSON(const std::string& s) {
+        std::istringstream strm(s);
+        return json::Load(strm).GetRoot();
+    }
+}
+
+TEST(JsonLoadTest, ParsesIntegers) {
+    EXPECT_TRUE(LoadJSON("42"s).IsInt());
+    EXPECT_EQ(LoadJSON("42"s).AsInt(), 42);
+    EXPECT_EQ(LoadJSON("-17"s).AsInt(), -17);
+    EXPECT_EQ(LoadJSON("0"s).AsInt(), 0);
+    EXPECT_EQ(LoadJSON("2147483647"s).AsInt(), 2147483647);
+}
+
+TEST(JsonLoadTest, IntOverflowFallsBackToDouble) {
+    const json::Node node = LoadJSON("2147483648"s);
+    EXPECT_TRUE(node.IsPureDouble());
+    EXPECT_DOUBLE_EQ(node.AsDouble(), 2147483648.);
+    EXPECT_TRUE(LoadJSON("-2147483649"s).IsPureDouble());
+}
+
+TEST(JsonLoadTest, ParsesDoubles) {
+    EXPECT_TRUE(LoadJSON("1.0"s).IsPureDouble());
+    EXPECT_DOUBLE_EQ(LoadJSON("55.611087"s).AsDouble(), 55.611087);
+    EXPECT_DOUBLE_EQ(LoadJSON("-1.5e3"s).AsDouble(), -1500.);
+    EXPECT_TRUE(LoadJSON("1e2"s).IsPureDouble());
+    EXPECT_DOUBLE_EQ(LoadJSON("1E+2"s).AsDouble(), 100.);
+}
+
+TEST(JsonLoadTest, RejectsMalformedNumbers) {
+    EXPECT_THROW(LoadJSON("-"s), json::ParsingError);
+    EXPECT_THROW(LoadJSON("1."s), json::ParsingError);
+    EXPECT_THROW(LoadJSON("1e"s), json::ParsingError);
+}
+
+TEST(JsonLoadTest, ParsesNestedValues) {
+    const json::Node node = LoadJSON(R"({"a": [1, 2.5, "x\"y\n", true, null], "b": {}})"s);
+    const json::Array& array = node.AsDict().at("a"s).AsArray();
+    ASSERT_EQ(array.size(), 5u);
+    EXPECT_EQ(array[0].AsInt(), 1);
+    EXPECT_DOUBLE_EQ(array[1].AsDouble(), 2.5);
+    EXPECT_EQ(array[2].AsString(), "x\"y\n"s);
+    EXPECT_TRUE(array[3].AsBool());
+    EXPECT_TRUE(array[4].IsNull());
+    EXPECT_TRUE(node.AsDict().at("b"s).AsDict().empty());
+}
+
+TEST(JsonLoadTest, RejectsUnterminatedContainers) {
+    EXPECT_THROW(LoadJSON("[1, 2"s), json::ParsingError);
+    EXPECT_THROW(LoadJSON(R"({"a": 1)"s), json::ParsingError);
+    EXPECT_THROW(LoadJSON(R"("abc)"s), json::ParsingError);
+}
+
+TEST(JsonWriterTest, MatchesPrintFormatting) {
+    const json::Node expected = json::Builder{}
+                                .StartArray()
+                                .StartDict()
+                                .Key("buses"s).StartArray().Value("14"s).Value("22к"s).EndArray()
+                                .Key("request_id"s).Value(1)
+                                .EndDict()
+                                .StartDict()
+                                .Key("curvature"s).Value(1.23456789)
+                                .Key("empty"s).StartArray().EndArray()
+                                .Key("map"s).Value("<svg a=\"b\">\n</svg>"s)
+                                .Key("null"s).Value(nullptr)
+                                .Key("ok"s).Value(true)
+                                .EndDict()
+                                .EndArray()
+                                .Build();
+    std::ostringstream expected_output;
+    json::Print(json::Document{expected}, expected_output);
+
+    io::OutputBuffer output;
+    json::Writer writer(output);
+    writer.StartArray()
+          .StartDict()
+          .Key("buses"sv).StartArray().Value("14"sv).Value("22к"sv).EndArray()
+          .Key("request_id"sv).Value(1)
+          .EndDict()
+          .StartDict()
+          .Key("curvature"sv).Value(1.23456789)
+          .Key("empty"sv).StartArray().EndArray()
+          .Key("map"sv).Value("<svg a=\"b\">\n</svg>"sv)
+          .Key("null"sv).Value(nullptr)
+          .Key("ok"sv).Value(true)
+          .EndDict()
+          .EndArray();
+
+    EXPECT_EQ(output.View(), expected_output.str());
+}
+
+TEST(JsonWriterTest, RejectsMisplacedKeys) {
+    io::OutputBuffer output;
+    json::Writer writer(output);
+    writer.StartArray();
+    EXPECT_THROW(writer.Key("key"sv), std::logic_error);
+    EXPECT_THROW(writer.EndDict(), std::logic_error);
+}
+
+TEST(JsonLoadTest, ParsesLargeArraysInOrder) {
+    // Массив больше порога параллельного разбора: на многоядерной машине он делится на части
+    std::string text = "{\"items\": ["s;
+    const int count = 100000;
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) {
+            text += ", "s;
+        }
+        text += R"({"id": )"s + std::to_string(i) + R"(, "name": "stop \"[)"s + std::to_string(i)
+            + R"(]\" ,", "tags": [1, {"a": "]"}]})"s;
+    }
+    text += "], \"tail\": true}"s;
+    ASSERT_GT(text.size(), 1u << 20);
+
+    const json::Node node = json::Load(std::string_view(text)).GetRoot();
+    const json::Array& items = node.AsDict().at("items"s).AsArray();
+    ASSERT_EQ(items.size(), static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(items[i].AsDict().at("id"s).AsInt(), i);
+        ASSERT_EQ(items[i].AsDict().at("name"s).AsString(), "stop \"["s + std::to_string(i) + "]\" ,"s);
+    }
+    EXPECT_TRUE(node.AsDict().at("tail"s).AsBool());
+
+    text.insert(text.find(", {"s), ", ,"s);
+    EXPECT_THROW(json::Load(std::string_view(text)), json::ParsingError);
+}
+
+TEST(JsonLoadTest, DefersValueOfRootKey) {
+    const std::string input = R"({"a": 1, "later": [{"x": "]"}, [2, 3]] , "b": {"c": null}})"s;
+    std::string_view deferred;
+    const json::Document document = json::LoadDeferring(input, "later"sv, deferred);
+    EXPECT_EQ(deferred, R"([{"x": "]"}, [2, 3]])"sv);
+    EXPECT_EQ(document.GetRoot(), LoadJSON(R"({"a": 1, "b": {"c": null}})"s));
+
+    json::ArrayReader reader(deferred);
+    std::optional<json::Node> first = reader.Next();
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(first->AsDict().at("x"s).AsString(), "]"s);
+    std::optional<json::Node> second = reader.Next();
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ(second->AsArray().size(), 2u);
+    EXPECT_FALSE(reader.Next().has_value());
+    EXPECT_FALSE(reader.Next().has_value());
+}
+
+TEST(JsonLoadTest, ArrayReaderRejectsUnterminatedArray) {
+    json::ArrayReader reader("[1, 2"sv);
+    EXPECT_EQ(reader.Next()->AsInt(), 1);
+    EXPECT_EQ(reader.Next()->AsInt(), 2);
+    EXPECT_THROW(reader.Next(), json::ParsingError);
+}
@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+
+#include "../transport-catalogue/latency_histogram.h"
+
+using namespace std::literals;
+using metrics::LatencyHistogram;
+
+TEST(LatencyHistogramTest, EmptyHistogramReportsZero) {
+    const auto histogram = std::make_unique<LatencyHistogram>();
+    EXPECT_EQ(histogram->GetCount(), 0u);
+    EXPECT_EQ(histogram->GetPercentile(0.99), 0ns);
+    EXPECT_EQ(histogram->GetMean(), 0ns);
+}
+
+TEST(LatencyHistogramTest, PercentilesAreWithinOnePercent) {
+    const auto histogram = std::make_unique<LatencyHistogram>();
+    for (int i = 1; i <= 10'000; ++i) {
+        histogram->Record(std::chrono::microseconds(i));
+    }
+    EXPECT_EQ(histogram->GetCount(), 10'000u);
+    EXPECT_EQ(histogram->GetMax(), 10'000us);
+    EXPECT_NEAR(histogram->GetPercentile(0.5).count(), 5'000'000., 50'000.);
+    EXPECT_NEAR(histogram->GetPercentile(0.99).count(), 9'900'000., 99'000.);
+    EXPECT_NEAR(histogram->GetPercentile(0.999).count(), 9'990'000., 99'900.);
+    EXPECT_NEAR(histogram->GetMean().count(), 5'000'500., 1.);
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+    const auto histogram = std::make_unique<LatencyHistogram>();
+    histogram->Record(3ns);
+    histogram->Record(100ns);
+    EXPECT_EQ(histogram->GetPercentile(0.5), 3ns);
+    EXPECT_EQ(histogram->GetPercentile(1.), 100ns);
+}
+
+TEST(LatencyHistogramTest, ClampsHugeValuesToLastBucket) {
+    const auto histogram = std::make_unique<LatencyHistogram>();
+    histogram->Record(24h);
+    EXPECT_EQ(histogram->GetCount(), 1u);
+    EXPECT_EQ(histogram->GetMax(), 24h);
+    EXPECT_GT(histogram->GetPercentile(0.5), 1h);
+}
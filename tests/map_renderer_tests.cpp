@@ -0,0 +1,25 @@
+#include <gtest/gtest.h>
+
+#include "../transport-catalogue/map_renderer.h"
+
+TEST(SimplifyPolylineTest, DropsPointsWithinTolerance) {
+    const std::vector<svg::Point> points{{0, 0}, {10, 0.2}, {10.3, 0.1}, {20, -0.3}, {30, 0}};
+    const std::vector<svg::Point> simplified = renderer::SimplifyPolyline(points, 1.);
+    ASSERT_EQ(simplified.size(), 2u);
+    EXPECT_DOUBLE_EQ(simplified.front().x, 0.);
+    EXPECT_DOUBLE_EQ(simplified.back().x, 30.);
+}
+
+TEST(SimplifyPolylineTest, KeepsPointsBeyondTolerance) {
+    const std::vector<svg::Point> points{{0, 0}, {10, 4}, {20, 8}, {30, 4}, {40, 0}};
+    const std::vector<svg::Point> simplified = renderer::SimplifyPolyline(points, 1.);
+    ASSERT_EQ(simplified.size(), 3u);
+    EXPECT_DOUBLE_EQ(simplified[1].x, 20.);
+    EXPECT_DOUBLE_EQ(simplified[1].y, 8.);
+}
+
+TEST(SimplifyPolylineTest, KeepsClosedRoutesClosed) {
+    const std::vector<svg::Point> points{{0, 0}, {10, 0}, {10, 10}, {0, 10}, {0, 0}};
+    const std::vector<svg::Point> simplified = renderer::SimplifyPolyline(points, 1.);
+    ASSERT_EQ(simplified.size(), 5u);
+}
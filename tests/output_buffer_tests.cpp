@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "../transport-catalogue/output_buffer.h"
+
+using namespace std::literals;
+
+TEST(OutputBufferTest, FormatsNumbersLikeOstream) {
+    const double doubles[] = {0., -0., 1., 0.1, 1.5, 123456., 1234567., 1e-5, 0.000123456789, 3.14159265358979,
+                              47237.2, 1.234567e+21, -98.76543};
+    for (const double value : doubles) {
+        std::ostringstream expected;
+        expected << value;
+        io::OutputBuffer buffer;
+        buffer << value;
+        EXPECT_EQ(buffer.View(), expected.str()) << value;
+    }
+
+    io::OutputBuffer buffer;
+    buffer << -2147483647 << ' ' << 42u << ' ' << size_t{18446744073709551615u};
+    EXPECT_EQ(buffer.View(), "-2147483647 42 18446744073709551615"sv);
+}
+
+TEST(OutputBufferTest, FormatsRandomDoublesLikeOstream) {
+    std::mt19937_64 generator(2024);
+    std::uniform_real_distribution<double> exponent(-7., 8.);
+    const double edge_cases[] = {1e-4, 9.999995e-5, 0.5, 99999.95, 999999.4, 999999.5, 123.4565, 0.0001234565};
+    std::vector<double> values(std::begin(edge_cases), std::end(edge_cases));
+    for (int i = 0; i < 100000; ++i) {
+        values.push_back(std::pow(10., exponent(generator)) * (i % 2 == 0 ? 1. : -1.));
+    }
+    for (const double value : values) {
+        std::ostringstream expected;
+        expected << value;
+        io::OutputBuffer buffer;
+        buffer << value;
+        ASSERT_EQ(buffer.View(), expected.str()) << value;
+    }
+}
+
+TEST(OutputBufferTest, FlushesToSinkWhenFull) {
+    std::ostringstream sink;
+    {
+        io::OutputBuffer buffer(sink, 8);
+        buffer << "0123"sv;
+        EXPECT_TRUE(sink.str().empty());
+        buffer << "456789"sv;
+        EXPECT_EQ(sink.str(), "0123456789"s);
+        buffer.WriteRepeated(' ', 3);
+    }
+    EXPECT_EQ(sink.str(), "0123456789   "s);
+}
+
+TEST(OutputBufferTest, EscapesTextInJsonMode) {
+    io::OutputBuffer buffer;
+    buffer << "<a>"sv;
+    buffer.SetJsonEscaping(true);
+    buffer << "<text x=\"1.5\">"sv << 2.5 << '\n' << "a\\b\t"sv;
+    buffer.SetJsonEscaping(false);
+    buffer << "\"end\""sv;
+    EXPECT_EQ(buffer.View(), R"(<a><text x=\"1.5\">2.5\na\\b\t"end")"sv);
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../transport-catalogue/request_scheduler.h"
+#include "../transport-catalogue/thread_pool.h"
+
+using namespace std::literals;
+using jsonreader::CostModel;
+using jsonreader::RequestScheduler;
+using jsonreader::StatRequest;
+
+TEST(CostModelTest, LimitsGrowthFromSingleSample) {
+    CostModel model;
+    const CostModel::Duration initial = model.Estimate(StatRequest::Type::STOP);
+    model.Record(StatRequest::Type::STOP, 1s);
+    EXPECT_LT(model.Estimate(StatRequest::Type::STOP), initial * 2);
+
+    for (int i = 0; i < 200; ++i) {
+        model.Record(StatRequest::Type::ROUTE, 10ms);
+    }
+    EXPECT_GT(model.Estimate(StatRequest::Type::ROUTE), 9ms);
+    EXPECT_LT(model.Estimate(StatRequest::Type::ROUTE), 11ms);
+}
+
+TEST(RequestSchedulerTest, KeepsOrderAndAnswersLateRequestsWithError) {
+    transport::Catalogue catalogue;
+    std::ostringstream output;
+    requesthandler::RequestHandler handler(catalogue, output, requesthandler::OutputMode::LINES);
+    RequestScheduler scheduler([](const StatRequest& request, requesthandler::RequestHandler& request_handler) {
+        request_handler.PrepareError(request.id, request.type == StatRequest::Type::MAP ? "map"s : "stop"s);
+        return true;
+    });
+
+    // Чередуем дешёвые и дорогие запросы, чтобы пакет разбился на задачи обоих видов
+    std::vector<StatRequest> requests;
+    std::string expected;
+    for (int id = 0; id < 600; ++id) {
+        StatRequest request;
+        request.id = id;
+        request.type = id % 50 == 0 ? StatRequest::Type::MAP : StatRequest::Type::STOP;
+        std::string message = request.type == StatRequest::Type::MAP ? "map"s : "stop"s;
+        if (id % 100 == 0) {
+            // Оценка Map заведомо больше миллисекунды
+            request.deadline_ms = 1;
+            message = "deadline exceeded"s;
+        }
+        requests.push_back(request);
+        expected += R"({"error_message":")" + message + R"(","request_id":)" + std::to_string(id) + "}\n";
+    }
+
+    scheduler.Run(requests, handler, RequestScheduler::Clock::now());
+    handler.Finish();
+    EXPECT_EQ(output.str(), expected);
+}
+
+TEST(RequestSchedulerTest, RunsRouteOnExpensivePoolUntilRouterIsBuilt) {
+    if (threading::GetHardwareConcurrency() <= 1) {
+        GTEST_SKIP() << "requests are scheduled on pools only with several threads";
+    }
+    transport::Catalogue catalogue;
+    std::ostringstream output;
+    requesthandler::RequestHandler handler(catalogue, output, requesthandler::OutputMode::LINES);
+    std::atomic<bool> router_built = false;
+    std::atomic<int> routes_on_expensive_pool = 0;
+    RequestScheduler scheduler(
+        [&](const StatRequest& request, requesthandler::RequestHandler& request_handler) {
+            if (request.type == StatRequest::Type::ROUTE) {
+                routes_on_expensive_pool += RequestScheduler::IsExpensiveRequestThread() ? 1 : 0;
+                router_built = true;
+            }
+            request_handler.PrepareError(request.id, "ok"s);
+            return true;
+        },
+        [&](StatRequest::Type type) {
+            return type == StatRequest::Type::ROUTE && !router_built;
+        });
+
+    // Оценка Route меньше порога дорогого запроса: дорогим его делает только неготовый маршрутизатор
+    EXPECT_TRUE(scheduler.IsExpensive(StatRequest::Type::ROUTE));
+    EXPECT_FALSE(scheduler.IsExpensive(StatRequest::Type::STOP));
+
+    std::vector<StatRequest> requests(300);
+    for (int id = 0; id < static_cast<int>(requests.size()); ++id) {
+        requests[id].id = id;
+        requests[id].type = id == 10 ? StatRequest::Type::ROUTE : StatRequest::Type::STOP;
+    }
+    scheduler.Run(requests, handler, RequestScheduler::Clock::now());
+    EXPECT_EQ(routes_on_expensive_pool, 1);
+
+    // После построения Route снова дешёвый и идёт вместе с остальными запросами
+    EXPECT_FALSE(scheduler.IsExpensive(StatRequest::Type::ROUTE));
+    scheduler.Run(requests, handler, RequestScheduler::Clock::now());
+    EXPECT_EQ(routes_on_expensive_pool, 1);
+}
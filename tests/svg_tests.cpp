@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include "../transport-catalogue/memory_accounting.h"
+#include "../transport-catalogue/output_buffer.h"
+#include "../transport-catalogue/svg.h"
+
+using namespace std::literals;
+
+namespace {
+    svg::Text MakeLabel(const std::string& data, const std::string& color) {
+        svg::Text text;
+        text.SetData(data).SetPosition({10, 20}).SetFontFamily("Verdana"s).SetFontSize(12).SetFillColor(color);
+        return text;
+    }
+
+    std::string RenderToString(const svg::Document& document) {
+        io::OutputBuffer out;
+        document.Render(out);
+        return out.Take();
+    }
+}
+
+TEST(SvgDocumentTest, AppendKeepsObjectOrderAndStyles) {
+    svg::Polyline line;
+    line.AddPoint({1, 2}).AddPoint({3, 4}).SetStrokeColor("red"s).SetStrokeWidth(2);
+    svg::Circle circle;
+    circle.SetCenter({5, 6}).SetRadius(3).SetFillColor("white"s);
+
+    svg::Document expected;
+    expected.Add(line);
+    expected.Add(MakeLabel("A & B"s, "black"s));
+    expected.Add(circle);
+    expected.Add(MakeLabel("<C>"s, "green"s));
+
+    svg::Document first;
+    first.Add(line);
+    first.Add(MakeLabel("A & B"s, "black"s));
+    svg::Document second;
+    second.Add(circle);
+    second.Add(MakeLabel("<C>"s, "green"s));
+    first.Append(std::move(second));
+
+    EXPECT_EQ(RenderToString(first), RenderToString(expected));
+    EXPECT_EQ(first.GetObjectCount(), 4u);
+}
+
+TEST(SvgDocumentTest, LargeDocumentRendersObjectsInOrder) {
+    // Документ больше порога параллельного вывода: части должны попасть в поток по порядку
+    constexpr int object_count = 20'000;
+    const std::string header = RenderToString(svg::Document());
+    const std::string_view footer = "</svg>"sv;
+
+    svg::Document document;
+    std::string expected = header.substr(0, header.size() - footer.size());
+    for (int i = 0; i < object_count; ++i) {
+        svg::Circle circle;
+        circle.SetCenter({static_cast<double>(i), static_cast<double>(i % 7)}).SetRadius(1 + i % 3);
+        svg::Document single;
+        single.Add(circle);
+        const std::string rendered = RenderToString(single);
+        expected += rendered.substr(header.size() - footer.size(),
+                                    rendered.size() - header.size());
+        document.Add(circle);
+    }
+    expected += footer;
+
+    std::ostringstream output;
+    document.Render(output);
+    EXPECT_EQ(output.str(), expected);
+}
+
+TEST(SvgDocumentTest, AddsRecordsWithoutPerObjectAllocations) {
+    if (!memory::IsTrackingEnabled()) {
+        GTEST_SKIP() << "allocations are counted only with TC_MEMORY_REPORT";
+    }
+    constexpr int object_count = 10'000;
+    const std::string stop_name = "Stop with a long enough name to need a heap buffer"s;
+    const std::vector<svg::Point> points{{0, 0}, {10, 10}, {20, 0}};
+
+    svg::Document document;
+    svg::PathStyle fill;
+    fill.fill_color = "white"s;
+    const svg::Document::StyleId circle_style = document.InternStyle(fill);
+    const svg::Document::TextStyle text_style{{7, -3}, 20, circle_style, document.InternString("Verdana"s),
+                                              document.InternString(std::string())};
+
+    // Выделения идут только на рост массивов записей, то есть их число растёт логарифмически
+    memory::ScopedSubsystem subsystem(memory::Subsystem::RENDERER);
+    const uint64_t allocations_before = memory::GetStats()[static_cast<size_t>(memory::Subsystem::RENDERER)].allocations;
+    for (int i = 0; i < object_count; ++i) {
+        document.AddCircle({static_cast<double>(i), 0}, 5, circle_style);
+        document.AddPolyline(points, circle_style);
+        document.AddText({static_cast<double>(i), 0}, stop_name, text_style);
+    }
+    const uint64_t allocations =
+        memory::GetStats()[static_cast<size_t>(memory::Subsystem::RENDERER)].allocations - allocations_before;
+    EXPECT_LT(allocations, 200u);
+    EXPECT_EQ(document.GetObjectCount(), 3u * object_count);
+}
+
+TEST(SvgDocumentTest, RecordsRenderLikeObjects) {
+    svg::Text label = MakeLabel("A & B"s, "black"s);
+    label.SetOffset({7, -3}).SetFontWeight("bold"s);
+    svg::Circle circle;
+    circle.SetCenter({5, 6}).SetRadius(3).SetFillColor("white"s);
+    svg::Polyline line;
+    line.AddPoint({1, 2}).AddPoint({3, 4}).SetStrokeColor("red"s).SetStrokeWidth(2);
+
+    svg::Document expected;
+    expected.Add(circle);
+    expected.Add(line);
+    expected.Add(label);
+
+    svg::Document document;
+    svg::PathStyle circle_style;
+    circle_style.fill_color = "white"s;
+    svg::PathStyle line_style;
+    line_style.stroke_color = "red"s;
+    line_style.stroke_width = 2;
+    svg::PathStyle label_style;
+    label_style.fill_color = "black"s;
+    const std::vector<svg::Point> points{{1, 2}, {3, 4}};
+    document.AddCircle({5, 6}, 3, document.InternStyle(circle_style));
+    document.AddPolyline(points, document.InternStyle(line_style));
+    document.AddText({10, 20}, "A & B"sv,
+                     {{7, -3}, 12, document.InternStyle(label_style), document.InternString("Verdana"s),
+                      document.InternString("bold"s)});
+
+    EXPECT_EQ(RenderToString(document), RenderToString(expected));
+}
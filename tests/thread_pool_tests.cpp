@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include "../transport-catalogue/bounded_queue.h"
+#include "../transport-catalogue/memory_accounting.h"
+#include "../transport-catalogue/sharded_counter.h"
+#include "../transport-catalogue/thread_pool.h"
+
+TEST(ThreadPoolTest, RunsTasksSubmittedFromWorkers) {
+    threading::ThreadPool pool(3);
+    std::atomic<int> sum = 0;
+    std::vector<std::future<std::vector<std::future<void>>>> outer;
+    for (int i = 0; i < 8; ++i) {
+        outer.push_back(pool.Submit([&pool, &sum, i] {
+            // Вложенные задачи попадают в очередь этого же потока, остальные потоки их забирают
+            std::vector<std::future<void>> inner;
+            for (int j = 0; j < 16; ++j) {
+                inner.push_back(pool.Submit([&sum, i, j] {
+                    sum += i * 16 + j;
+                }));
+            }
+            return inner;
+        }));
+    }
+    for (auto& outer_task : outer) {
+        for (std::future<void>& task : outer_task.get()) {
+            task.get();
+        }
+    }
+    EXPECT_EQ(sum, 127 * 128 / 2);
+}
+
+TEST(ThreadPoolTest, PassesExceptionsThroughFuture) {
+    threading::ThreadPool pool(2);
+    std::future<int> result = pool.Submit([]() -> int {
+        throw std::runtime_error("failed");
+    });
+    EXPECT_THROW(result.get(), std::runtime_error);
+    EXPECT_EQ(pool.Submit([] { return 42; }).get(), 42);
+}
+
+TEST(ThreadPoolTest, ParallelForVisitsEveryIndexOnce) {
+    std::vector<int> visits(1000);
+    threading::ParallelFor(visits.size(), [&](size_t i) {
+        ++visits[i];
+    });
+    EXPECT_EQ(std::accumulate(visits.begin(), visits.end(), 0), 1000);
+    EXPECT_EQ(*std::min_element(visits.begin(), visits.end()), 1);
+}
+
+TEST(ThreadPoolTest, AttributesTaskMemoryToSubmittingSubsystem) {
+    if (!memory::IsTrackingEnabled()) {
+        GTEST_SKIP() << "memory is accounted only with TC_MEMORY_REPORT";
+    }
+    constexpr int task_count = 8;
+    constexpr size_t block_size = 1 << 20;
+    const auto router_bytes = [] {
+        return memory::GetStats()[static_cast<size_t>(memory::Subsystem::ROUTER)].current_bytes;
+    };
+
+    threading::ThreadPool pool(4);
+    std::vector<std::future<std::unique_ptr<std::vector<char>>>> blocks;
+    const int64_t bytes_before = router_bytes();
+    {
+        memory::ScopedSubsystem subsystem(memory::Subsystem::ROUTER);
+        for (int i = 0; i < task_count; ++i) {
+            blocks.push_back(pool.Submit([block_size] {
+                return std::make_unique<std::vector<char>>(block_size);
+            }));
+        }
+    }
+    std::vector<std::unique_ptr<std::vector<char>>> results;
+    for (auto& block : blocks) {
+        results.push_back(block.get());
+    }
+    // Блоки выделены в потоках пула, но учтены в подсистеме, поставившей задачи
+    EXPECT_GE(router_bytes() - bytes_before, static_cast<int64_t>(task_count * block_size));
+}
+
+TEST(BoundedQueueTest, PassesEveryValueOnce) {
+    threading::BoundedQueue<int> queue(5);
+    int value = 0;
+    EXPECT_FALSE(queue.TryPop(value));
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_TRUE(queue.TryPush(i));
+    }
+    int extra = 8;
+    EXPECT_FALSE(queue.TryPush(extra));
+    EXPECT_EQ(queue.Pop(), 0);
+
+    constexpr int PRODUCERS = 3;
+    constexpr int VALUES_PER_PRODUCER = 10000;
+    threading::BoundedQueue<int> shared_queue(16);
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < PRODUCERS; ++producer) {
+        producers.emplace_back([&shared_queue, producer] {
+            for (int i = 0; i < VALUES_PER_PRODUCER; ++i) {
+                shared_queue.Push(producer * VALUES_PER_PRODUCER + i);
+            }
+        });
+    }
+    std::vector<int> seen(PRODUCERS * VALUES_PER_PRODUCER);
+    std::vector<int> last_from_producer(PRODUCERS, -1);
+    for (size_t i = 0; i < seen.size(); ++i) {
+        const int received = shared_queue.Pop();
+        ++seen[received];
+        // Значения одного писателя приходят в порядке записи
+        EXPECT_GT(received, last_from_producer[received / VALUES_PER_PRODUCER]);
+        last_from_producer[received / VALUES_PER_PRODUCER] = received;
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    EXPECT_EQ(*std::min_element(seen.begin(), seen.end()), 1);
+    EXPECT_EQ(*std::max_element(seen.begin(), seen.end()), 1);
+}
+
+TEST(BoundedQueueTest, BlocksWithoutBusyWaiting) {
+    threading::BoundedQueue<int> queue(4);
+    std::promise<std::chrono::nanoseconds> consumer_cpu_time;
+    std::thread consumer([&] {
+        const int value = queue.Pop();
+        timespec cpu_time{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time);
+        EXPECT_EQ(value, 42);
+        consumer_cpu_time.set_value(std::chrono::seconds(cpu_time.tv_sec)
+                                    + std::chrono::nanoseconds(cpu_time.tv_nsec));
+    });
+
+    // Пока элемента нет, ждущий поток должен спать, а не крутиться на процессоре
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    queue.Push(42);
+    const std::chrono::nanoseconds cpu_time = consumer_cpu_time.get_future().get();
+    consumer.join();
+    EXPECT_LT(cpu_time, std::chrono::milliseconds(50));
+}
+
+TEST(ShardedCounterTest, SumsAddsFromAllThreads) {
+    metrics::ShardedCounter counter;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 20; ++i) {
+        threads.emplace_back([&counter] {
+            for (int j = 0; j < 1000; ++j) {
+                counter.Add(2);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(counter.Get(), 40'000u);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace threading {
+    /*
+     * Ограниченная очередь без блокировок для нескольких писателей и читателей
+     * (кольцевой буфер Д. Вьюкова). Каждая ячейка хранит номер, по которому писатель
+     * и читатель узнают, чья сейчас очередь её занять. Ёмкость округляется вверх до степени двойки.
+     * Push и Pop ждут, пока в очереди появится место или элемент: сначала недолго повторяют
+     * попытку, затем засыпают до следующего извлечения или добавления и процессор не занимают
+     */
+    template <typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity) {
+            size_t rounded_capacity = 2;
+            while (rounded_capacity < capacity) {
+                rounded_capacity *= 2;
+            }
+            mask_ = rounded_capacity - 1;
+            cells_ = std::make_unique<Cell[]>(rounded_capacity);
+            for (size_t i = 0; i < rounded_capacity; ++i) {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        // Перемещает value в очередь; если очередь заполнена, возвращает false и не трогает value
+        bool TryPush(T& value) {
+            Cell* cell = nullptr;
+            size_t position = enqueue_position_.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &cells_[position & mask_];
+                const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                const auto difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+                if (difference == 0) {
+                    if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                else if (difference < 0) {
+                    return false;
+                }
+                else {
+                    position = enqueue_position_.load(std::memory_order_relaxed);
+                }
+            }
+            cell->value = std::move(value);
+            cell->sequence.store(position + 1, std::memory_order_release);
+            pushed_.Notify();
+            return true;
+        }
+
+        bool TryPop(T& value) {
+            Cell* cell = nullptr;
+            size_t position = dequeue_position_.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &cells_[position & mask_];
+                const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                const auto difference =
+                    static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+                if (difference == 0) {
+                    if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                else if (difference < 0) {
+                    return false;
+                }
+                else {
+                    position = dequeue_position_.load(std::memory_order_relaxed);
+                }
+            }
+            value = std::move(cell->value);
+            cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+            popped_.Notify();
+            return true;
+        }
+
+        void Push(T value) {
+            WaitUntil(popped_, [&] {
+                return TryPush(value);
+            });
+        }
+
+        T Pop() {
+            T value;
+            WaitUntil(pushed_, [&] {
+                return TryPop(value);
+            });
+            return value;
+        }
+
+    private:
+        static constexpr size_t CACHE_LINE_SIZE = 64;
+        static constexpr size_t SPIN_ATTEMPTS = 64;
+
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        // Сигнал о добавлении или извлечении элемента. Номер события меняется при каждом сигнале,
+        // поэтому ждущий, прочитавший номер до неудачной попытки, не пропустит сигнал после неё.
+        // Будить ждущих (системный вызов) нужно только тогда, когда они есть
+        struct alignas(CACHE_LINE_SIZE) Signal {
+            std::atomic<uint32_t> epoch = 0;
+            std::atomic<uint32_t> waiters = 0;
+
+            void Notify() {
+                epoch.fetch_add(1);
+                if (waiters.load() > 0) {
+                    epoch.notify_all();
+                }
+            }
+        };
+
+        std::unique_ptr<Cell[]> cells_;
+        size_t mask_ = 0;
+        // Позиции писателей и читателей лежат в разных кэш-линиях, чтобы не мешать друг другу
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_position_ = 0;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_position_ = 0;
+        Signal pushed_;
+        Signal popped_;
+
+        template <typename TryOperation>
+        static void WaitUntil(Signal& signal, TryOperation try_operation) {
+            for (size_t attempt = 0; attempt < SPIN_ATTEMPTS; ++attempt) {
+                if (try_operation()) {
+                    return;
+                }
+            }
+            signal.waiters.fetch_add(1);
+            while (true) {
+                const uint32_t epoch = signal.epoch.load();
+                if (try_operation()) {
+                    break;
+                }
+                signal.epoch.wait(epoch);
+            }
+            signal.waiters.fetch_sub(1);
+        }
+    };
+}
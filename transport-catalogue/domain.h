@@ -25,6 +25,8 @@ namespace transport {
         std::string name;
         geo::Coordinates coordinates;
         std::set<const Bus*, details::BusComparator> passing_busses = {};
+        // Порядковый номер остановки в справочнике, задаётся при добавлении
+        size_t index = 0;
     };
 
     namespace details {
@@ -0,0 +1,103 @@
+#include "gzip_stream.h"
+
+#include <stdexcept>
+
+namespace io {
+    using namespace std::literals;
+
+    namespace {
+        constexpr char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        // 16 к windowBits включает заголовок и контрольную сумму gzip вместо zlib
+        constexpr int GZIP_WINDOW_BITS = 15 + 16;
+        constexpr int MEMORY_LEVEL = 8;
+        constexpr size_t DEFLATE_CHUNK_SIZE = 1 << 14;
+    }
+
+    GzipBase64Streambuf::GzipBase64Streambuf(std::string& output, int level)
+        : output_(output) {
+        if (deflateInit2(&stream_, level, Z_DEFLATED, GZIP_WINDOW_BITS, MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("Failed to initialize gzip compression"s);
+        }
+    }
+
+    GzipBase64Streambuf::~GzipBase64Streambuf() {
+        deflateEnd(&stream_);
+    }
+
+    void GzipBase64Streambuf::Finish() {
+        if (finished_) {
+            return;
+        }
+        Deflate(nullptr, 0, Z_FINISH);
+        AppendBase64Tail();
+        finished_ = true;
+    }
+
+    GzipBase64Streambuf::int_type GzipBase64Streambuf::overflow(int_type ch) {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            return traits_type::not_eof(ch);
+        }
+        const char c = traits_type::to_char_type(ch);
+        xsputn(&c, 1);
+        return ch;
+    }
+
+    std::streamsize GzipBase64Streambuf::xsputn(const char* data, std::streamsize count) {
+        if (finished_) {
+            throw std::logic_error("Write after gzip stream is finished"s);
+        }
+        Deflate(data, static_cast<size_t>(count), Z_NO_FLUSH);
+        return count;
+    }
+
+    void GzipBase64Streambuf::Deflate(const char* data, size_t size, int flush) {
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream_.avail_in = static_cast<uInt>(size);
+        unsigned char chunk[DEFLATE_CHUNK_SIZE];
+        int result = Z_OK;
+        do {
+            stream_.next_out = chunk;
+            stream_.avail_out = sizeof(chunk);
+            result = deflate(&stream_, flush);
+            if (result == Z_STREAM_ERROR) {
+                throw std::runtime_error("gzip compression failed"s);
+            }
+            AppendBase64(chunk, sizeof(chunk) - stream_.avail_out);
+        } while (stream_.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+    }
+
+    void GzipBase64Streambuf::AppendBase64(const unsigned char* data, size_t size) {
+        size_t position = 0;
+        // Сначала дополняется тройка, оставшаяся с прошлого вызова
+        while (pending_size_ > 0 && pending_size_ < 3 && position < size) {
+            pending_[pending_size_++] = data[position++];
+        }
+        if (pending_size_ == 3) {
+            AppendBase64Tail();
+        }
+        for (; position + 3 <= size; position += 3) {
+            const unsigned value = (data[position] << 16) | (data[position + 1] << 8) | data[position + 2];
+            output_.push_back(BASE64_ALPHABET[(value >> 18) & 0x3F]);
+            output_.push_back(BASE64_ALPHABET[(value >> 12) & 0x3F]);
+            output_.push_back(BASE64_ALPHABET[(value >> 6) & 0x3F]);
+            output_.push_back(BASE64_ALPHABET[value & 0x3F]);
+        }
+        while (position < size) {
+            pending_[pending_size_++] = data[position++];
+        }
+    }
+
+    void GzipBase64Streambuf::AppendBase64Tail() {
+        if (pending_size_ == 0) {
+            return;
+        }
+        const unsigned value = (pending_[0] << 16) | (pending_size_ > 1 ? pending_[1] << 8 : 0)
+                               | (pending_size_ > 2 ? pending_[2] : 0);
+        output_.push_back(BASE64_ALPHABET[(value >> 18) & 0x3F]);
+        output_.push_back(BASE64_ALPHABET[(value >> 12) & 0x3F]);
+        output_.push_back(pending_size_ > 1 ? BASE64_ALPHABET[(value >> 6) & 0x3F] : '=');
+        output_.push_back(pending_size_ > 2 ? BASE64_ALPHABET[value & 0x3F] : '=');
+        pending_size_ = 0;
+    }
+}
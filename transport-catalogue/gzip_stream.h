@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <streambuf>
+#include <string>
+
+#include <zlib.h>
+
+namespace io {
+    /*
+     * Потоковый буфер, который сжимает записанные в него байты в формат gzip и дописывает
+     * результат в строку output в кодировке base64. Сжатие идёт по мере записи, поэтому
+     * несжатые данные целиком в памяти не хранятся. Finish завершает поток gzip,
+     * после него запись запрещена. Ошибки zlib выбрасываются как std::runtime_error
+     */
+    class GzipBase64Streambuf : public std::streambuf {
+    public:
+        explicit GzipBase64Streambuf(std::string& output, int level = Z_DEFAULT_COMPRESSION);
+
+        GzipBase64Streambuf(const GzipBase64Streambuf&) = delete;
+
+        GzipBase64Streambuf& operator=(const GzipBase64Streambuf&) = delete;
+
+        ~GzipBase64Streambuf() override;
+
+        void Finish();
+
+    protected:
+        int_type overflow(int_type ch) override;
+
+        std::streamsize xsputn(const char* data, std::streamsize count) override;
+
+    private:
+        std::string& output_;
+        z_stream stream_{};
+        // Сжатые байты, ещё не закодированные в base64: кодируются тройками
+        std::array<unsigned char, 3> pending_{};
+        size_t pending_size_ = 0;
+        bool finished_ = false;
+
+        void Deflate(const char* data, size_t size, int flush);
+
+        void AppendBase64(const unsigned char* data, size_t size);
+
+        void AppendBase64Tail();
+    };
+}
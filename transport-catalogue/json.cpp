@@ -1,45 +1,312 @@
 #include "json.h"
 
-#include <iterator>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <optional>
+
+#include "memory_accounting.h"
+#include "output_buffer.h"
+#include "thread_pool.h"
 
 namespace json {
     namespace {
         using namespace std::literals;
 
-        Node LoadNode(std::istream& input);
+        // Буфер с разбираемым текстом. Повторяет ту часть интерфейса std::istream,
+        // которой пользуется парсер, но позволяет читать числа и строки прямо из памяти
+        class InputBuffer {
+        public:
+            explicit InputBuffer(std::string_view data, bool allow_parallel = true)
+                : data_(data), allow_parallel_(allow_parallel) {}
 
-        Node LoadString(std::istream& input);
+            int Peek() const {
+                return pos_ < data_.size() ? static_cast<unsigned char>(data_[pos_]) : EOF;
+            }
 
-        std::string LoadLiteral(std::istream& input) {
-            std::string s;
-            while (std::isalpha(input.peek())) {
-                s.push_back(static_cast<char>(input.get()));
+            int Get() {
+                return pos_ < data_.size() ? static_cast<unsigned char>(data_[pos_++]) : EOF;
             }
-            return s;
+
+            // Аналог input >> c: пропускает пробельные символы и считывает следующий символ
+            bool ReadNonSpace(char& c) {
+                while (pos_ < data_.size() && std::isspace(static_cast<unsigned char>(data_[pos_]))) {
+                    ++pos_;
+                }
+                if (pos_ == data_.size()) {
+                    return false;
+                }
+                c = data_[pos_++];
+                return true;
+            }
+
+            void Putback() {
+                --pos_;
+            }
+
+            const char* Current() const {
+                return data_.data() + pos_;
+            }
+
+            const char* End() const {
+                return data_.data() + data_.size();
+            }
+
+            void Advance(size_t count) {
+                pos_ += count;
+            }
+
+            std::string_view Remaining() const {
+                return data_.substr(pos_);
+            }
+
+            // Глубина вложенности массивов и словарей, которые сейчас разбираются
+            size_t GetDepth() const {
+                return depth_;
+            }
+
+            bool AllowsParallel() const {
+                return allow_parallel_;
+            }
+
+            void Enter() {
+                ++depth_;
+            }
+
+            void Leave() {
+                --depth_;
+            }
+
+        private:
+            std::string_view data_;
+            size_t pos_ = 0;
+            size_t depth_ = 0;
+            bool allow_parallel_;
+        };
+
+        // Учитывает вложенность разбираемого массива или словаря
+        class NestingGuard {
+        public:
+            explicit NestingGuard(InputBuffer& input)
+                : input_(input) {
+                input_.Enter();
+            }
+
+            NestingGuard(const NestingGuard&) = delete;
+
+            NestingGuard& operator=(const NestingGuard&) = delete;
+
+            ~NestingGuard() {
+                input_.Leave();
+            }
+
+        private:
+            InputBuffer& input_;
+        };
+
+        // Массивы от этого размера в байтах разбираются параллельно
+        constexpr size_t PARALLEL_ARRAY_THRESHOLD = 1 << 20;
+        // Параллельно разбираются только массивы на первых уровнях вложенности,
+        // чтобы предварительный просмотр не повторялся для каждого вложенного массива
+        constexpr size_t PARALLEL_ARRAY_MAX_DEPTH = 2;
+        // Число частей массива на один поток пула: выравнивает нагрузку при неравных элементах
+        constexpr size_t PARALLEL_CHUNKS_PER_THREAD = 4;
+
+        Node LoadNode(InputBuffer& input);
+
+        std::string LoadString(InputBuffer& input);
+
+        std::string_view LoadLiteral(InputBuffer& input) {
+            const char* begin = input.Current();
+            while (std::isalpha(input.Peek())) {
+                input.Advance(1);
+            }
+            return {begin, static_cast<size_t>(input.Current() - begin)};
+        }
+
+        // Разбирает элементы массива до конца input. Если after_separator == true,
+        // перед input стояла запятая, поэтому первым обязан идти элемент
+        Array LoadArrayElements(InputBuffer& input, bool after_separator) {
+            Array result;
+            if (after_separator) {
+                result.push_back(LoadNode(input));
+            }
+            char c = 0;
+            while (input.ReadNonSpace(c)) {
+                if (c != ',') {
+                    input.Putback();
+                }
+                result.push_back(LoadNode(input));
+            }
+            return result;
+        }
+
+        // Быстрый структурный просмотр массива, начиная сразу после '['.
+        // Запоминает позиции запятых верхнего уровня и возвращает позицию закрывающей ']'
+        // либо std::nullopt, если массив не закрыт
+        std::optional<size_t> ScanArray(std::string_view data, std::vector<size_t>& separators) {
+            size_t depth = 0;
+            for (size_t pos = 0; pos < data.size(); ++pos) {
+                switch (data[pos]) {
+                case '"':
+                    // Пропускаем строку целиком вместе с экранированными символами
+                    pos = data.find_first_of("\"\\"sv, pos + 1);
+                    while (pos != std::string_view::npos && data[pos] == '\\') {
+                        pos = data.find_first_of("\"\\"sv, pos + 2);
+                    }
+                    if (pos == std::string_view::npos) {
+                        return std::nullopt;
+                    }
+                    break;
+                case '[':
+                    [[fallthrough]];
+                case '{':
+                    ++depth;
+                    break;
+                case ']':
+                    [[fallthrough]];
+                case '}':
+                    if (depth == 0) {
+                        return data[pos] == ']' ? std::optional(pos) : std::nullopt;
+                    }
+                    --depth;
+                    break;
+                case ',':
+                    if (depth == 0) {
+                        separators.push_back(pos);
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+            return std::nullopt;
         }
 
-        Node LoadArray(std::istream& input) {
+        // Разбирает большой массив по частям в общем пуле потоков и склеивает части по порядку.
+        // Возвращает std::nullopt, если массив выгоднее или необходимо разобрать последовательно
+        std::optional<Node> LoadArrayParallel(InputBuffer& input) {
+            const std::string_view data = input.Remaining();
+            std::vector<size_t> separators;
+            const std::optional<size_t> array_end = ScanArray(data, separators);
+            if (!array_end || *array_end < PARALLEL_ARRAY_THRESHOLD || separators.empty()) {
+                return std::nullopt;
+            }
+
+            // Делим массив по запятым верхнего уровня на части примерно равного размера
+            threading::ThreadPool& pool = threading::GetSharedPool();
+            const size_t chunk_count = std::min(pool.GetThreadCount() * PARALLEL_CHUNKS_PER_THREAD,
+                                                separators.size() + 1);
+            std::vector<std::string_view> chunks;
+            size_t chunk_begin = 0;
+            for (size_t i = 1; i < chunk_count; ++i) {
+                const auto separator = std::lower_bound(separators.begin(), separators.end(),
+                                                        *array_end * i / chunk_count);
+                if (separator == separators.end()) {
+                    break;
+                }
+                if (*separator < chunk_begin) {
+                    continue;
+                }
+                chunks.push_back(data.substr(chunk_begin, *separator - chunk_begin));
+                chunk_begin = *separator + 1;
+            }
+            chunks.push_back(data.substr(chunk_begin, *array_end - chunk_begin));
+
+            std::vector<std::future<Array>> parts;
+            parts.reserve(chunks.size());
+            for (size_t i = 0; i < chunks.size(); ++i) {
+                parts.push_back(pool.Submit([chunk = chunks[i], after_separator = i > 0] {
+                    InputBuffer chunk_input(chunk, false);
+                    return LoadArrayElements(chunk_input, after_separator);
+                }));
+            }
+            // Дожидаемся всех частей, прежде чем пробрасывать ошибку: они читают общий буфер
+            for (const auto& part : parts) {
+                part.wait();
+            }
+
+            Array result;
+            for (auto& part : parts) {
+                Array elements = part.get();
+                if (result.empty()) {
+                    result = std::move(elements);
+                }
+                else {
+                    result.insert(result.end(), std::make_move_iterator(elements.begin()),
+                                  std::make_move_iterator(elements.end()));
+                }
+            }
+            input.Advance(*array_end + 1);
+            return Node(std::move(result));
+        }
+
+        Node LoadArray(InputBuffer& input) {
+            if (input.AllowsParallel() && input.GetDepth() < PARALLEL_ARRAY_MAX_DEPTH
+                && input.Remaining().size() >= PARALLEL_ARRAY_THRESHOLD
+                && threading::GetHardwareConcurrency() > 1) {
+                NestingGuard guard(input);
+                if (std::optional<Node> result = LoadArrayParallel(input)) {
+                    return std::move(*result);
+                }
+            }
+
+            NestingGuard guard(input);
             std::vector<Node> result;
 
-            for (char c; input >> c && c != ']';) {
+            char c = 0;
+            while (input.ReadNonSpace(c) && c != ']') {
                 if (c != ',') {
-                    input.putback(c);
+                    input.Putback();
                 }
                 result.push_back(LoadNode(input));
             }
-            if (!input) {
+            if (c != ']') {
                 throw ParsingError("Array parsing error"s);
             }
             return Node(std::move(result));
         }
 
-        Node LoadDict(std::istream& input) {
+        // Пропускает значение, не строя его. Массивы только просматриваются
+        void SkipNode(InputBuffer& input) {
+            char c = 0;
+            if (!input.ReadNonSpace(c)) {
+                throw ParsingError("Unexpected EOF"s);
+            }
+            if (c == '[') {
+                std::vector<size_t> separators;
+                const std::optional<size_t> array_end = ScanArray(input.Remaining(), separators);
+                if (!array_end) {
+                    throw ParsingError("Array parsing error"s);
+                }
+                input.Advance(*array_end + 1);
+                return;
+            }
+            input.Putback();
+            LoadNode(input);
+        }
+
+        // Значение ключа deferred_key, если он задан, пропускается, а его текст записывается в deferred_value
+        Node LoadDict(InputBuffer& input, std::string_view deferred_key = {},
+                      std::string_view* deferred_value = nullptr) {
+            NestingGuard guard(input);
             Dict dict;
 
-            for (char c; input >> c && c != '}';) {
+            char c = 0;
+            while (input.ReadNonSpace(c) && c != '}') {
                 if (c == '"') {
-                    std::string key = LoadString(input).AsString();
-                    if (input >> c && c == ':') {
+                    std::string key = LoadString(input);
+                    if (input.ReadNonSpace(c) && c == ':') {
+                        if (deferred_value != nullptr && key == deferred_key) {
+                            while (std::isspace(input.Peek())) {
+                                input.Advance(1);
+                            }
+                            const char* value_begin = input.Current();
+                            SkipNode(input);
+                            *deferred_value = {value_begin, static_cast<size_t>(input.Current() - value_begin)};
+                            continue;
+                        }
                         if (dict.find(key) != dict.end()) {
                             throw ParsingError("Duplicate key '"s + key + "' have been found");
                         }
@@ -53,32 +320,37 @@ namespace json {
                     throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
                 }
             }
-            if (!input) {
+            if (c != '}') {
                 throw ParsingError("Dictionary parsing error"s);
             }
             return Node(std::move(dict));
         }
 
-        Node LoadString(std::istream& input) {
-            auto it = std::istreambuf_iterator<char>(input);
-            auto end = std::istreambuf_iterator<char>();
+        std::string LoadString(InputBuffer& input) {
             std::string s;
             while (true) {
-                if (it == end) {
+                // Участок строки без кавычек, экранирования и переводов строки копируется целиком
+                const char* run_begin = input.Current();
+                const char* run_end = run_begin;
+                while (run_end != input.End() && *run_end != '"' && *run_end != '\\'
+                       && *run_end != '\n' && *run_end != '\r') {
+                    ++run_end;
+                }
+                s.append(run_begin, run_end);
+                input.Advance(run_end - run_begin);
+
+                const int ch = input.Get();
+                if (ch == EOF) {
                     throw ParsingError("String parsing error");
                 }
-                const char ch = *it;
                 if (ch == '"') {
-                    ++it;
                     break;
                 }
                 else if (ch == '\\') {
-                    ++it;
-                    if (it == end) {
-                        throw ParsingError("String parsing error");
-                    }
-                    const char escaped_char = *(it);
+                    const int escaped_char = input.Get();
                     switch (escaped_char) {
+                    case EOF:
+                        throw ParsingError("String parsing error");
                     case 'n':
                         s.push_back('\n');
                         break;
@@ -95,22 +367,18 @@ namespace json {
                         s.push_back('\\');
                         break;
                     default:
-                        throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+                        throw ParsingError("Unrecognized escape sequence \\"s + static_cast<char>(escaped_char));
                     }
                 }
-                else if (ch == '\n' || ch == '\r') {
-                    throw ParsingError("Unexpected end of line"s);
-                }
                 else {
-                    s.push_back(ch);
+                    throw ParsingError("Unexpected end of line"s);
                 }
-                ++it;
             }
 
-            return Node(std::move(s));
+            return s;
         }
 
-        Node LoadBool(std::istream& input) {
+        Node LoadBool(InputBuffer& input) {
             const auto s = LoadLiteral(input);
             if (s == "true"sv) {
                 return Node{true};
@@ -119,46 +387,38 @@ namespace json {
                 return Node{false};
             }
             else {
-                throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+                throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
             }
         }
 
-        Node LoadNull(std::istream& input) {
+        Node LoadNull(InputBuffer& input) {
             if (auto literal = LoadLiteral(input); literal == "null"sv) {
                 return Node{nullptr};
             }
             else {
-                throw ParsingError("Failed to parse '"s + literal + "' as null"s);
+                throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
             }
         }
 
-        Node LoadNumber(std::istream& input) {
-            std::string parsed_num;
-
-            // Считывает в parsed_num очередной символ из input
-            auto read_char = [&parsed_num, &input] {
-                parsed_num += static_cast<char>(input.get());
-                if (!input) {
-                    throw ParsingError("Failed to read number from stream"s);
-                }
-            };
+        Node LoadNumber(InputBuffer& input) {
+            const char* const begin = input.Current();
 
-            // Считывает одну или более цифр в parsed_num из input
-            auto read_digits = [&input, read_char] {
-                if (!std::isdigit(input.peek())) {
+            // Считывает одну или более цифр из input
+            auto read_digits = [&input] {
+                if (!std::isdigit(input.Peek())) {
                     throw ParsingError("A digit is expected"s);
                 }
-                while (std::isdigit(input.peek())) {
-                    read_char();
+                while (std::isdigit(input.Peek())) {
+                    input.Advance(1);
                 }
             };
 
-            if (input.peek() == '-') {
-                read_char();
+            if (input.Peek() == '-') {
+                input.Advance(1);
             }
             // Парсим целую часть числа
-            if (input.peek() == '0') {
-                read_char();
+            if (input.Peek() == '0') {
+                input.Advance(1);
                 // После 0 в JSON не могут идти другие цифры
             }
             else {
@@ -167,43 +427,42 @@ namespace json {
 
             bool is_int = true;
             // Парсим дробную часть числа
-            if (input.peek() == '.') {
-                read_char();
+            if (input.Peek() == '.') {
+                input.Advance(1);
                 read_digits();
                 is_int = false;
             }
 
             // Парсим экспоненциальную часть числа
-            if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-                read_char();
-                if (ch = input.peek(); ch == '+' || ch == '-') {
-                    read_char();
+            if (int ch = input.Peek(); ch == 'e' || ch == 'E') {
+                input.Advance(1);
+                if (ch = input.Peek(); ch == '+' || ch == '-') {
+                    input.Advance(1);
                 }
                 read_digits();
                 is_int = false;
             }
 
-            try {
-                if (is_int) {
-                    // Сначала пробуем преобразовать строку в int
-                    try {
-                        return std::stoi(parsed_num);
-                    }
-                    catch (...) {
-                        // В случае неудачи, например, при переполнении
-                        // код ниже попробует преобразовать строку в double
-                    }
+            const char* const end = input.Current();
+            if (is_int) {
+                // Сначала пробуем преобразовать число в int
+                int int_value;
+                if (const auto [ptr, ec] = std::from_chars(begin, end, int_value); ec == std::errc{} && ptr == end) {
+                    return int_value;
                 }
-                return std::stod(parsed_num);
+                // В случае неудачи, например, при переполнении
+                // код ниже преобразует число в double
             }
-            catch (...) {
-                throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+            double double_value;
+            if (const auto [ptr, ec] = std::from_chars(begin, end, double_value); ec == std::errc{} && ptr == end) {
+                return double_value;
             }
+            throw ParsingError("Failed to convert "s + std::string(begin, end) + " to number"s);
         }
 
-        Node LoadNode(std::istream& input) {
+        Node LoadNode(InputBuffer& input) {
             char c;
-            if (!(input >> c)) {
+            if (!input.ReadNonSpace(c)) {
                 throw ParsingError("Unexpected EOF"s);
             }
             switch (c) {
@@ -222,26 +481,24 @@ namespace json {
                 // литералов true либо false
                 [[fallthrough]];
             case 'f':
-                input.putback(c);
+                input.Putback();
                 return LoadBool(input);
             case 'n':
-                input.putback(c);
+                input.Putback();
                 return LoadNull(input);
             default:
-                input.putback(c);
+                input.Putback();
                 return LoadNumber(input);
             }
         }
 
         struct PrintContext {
-            std::ostream& out;
+            io::OutputBuffer& out;
             int indent_step = 4;
             int indent = 0;
 
             void PrintIndent() const {
-                for (int i = 0; i < indent; ++i) {
-                    out.put(' ');
-                }
+                out.WriteRepeated(' ', indent);
             }
 
             PrintContext Indented() const {
@@ -256,36 +513,9 @@ namespace json {
             ctx.out << value;
         }
 
-        void PrintString(const std::string& value, std::ostream& out) {
-            out.put('"');
-            for (const char c : value) {
-                switch (c) {
-                case '\r':
-                    out << "\\r"sv;
-                    break;
-                case '\n':
-                    out << "\\n"sv;
-                    break;
-                case '\t':
-                    out << "\\t"sv;
-                    break;
-                case '"':
-                    // Символы " и \ выводятся как \" или \\, соответственно
-                    [[fallthrough]];
-                case '\\':
-                    out.put('\\');
-                    [[fallthrough]];
-                default:
-                    out.put(c);
-                    break;
-                }
-            }
-            out.put('"');
-        }
-
         template <>
         void PrintValue<std::string>(const std::string& value, const PrintContext& ctx) {
-            PrintString(value, ctx.out);
+            detail::PrintString(ctx.out, value);
         }
 
         template <>
@@ -304,7 +534,7 @@ namespace json {
 
         template <>
         void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
-            std::ostream& out = ctx.out;
+            io::OutputBuffer& out = ctx.out;
             out << "[\n"sv;
             bool first = true;
             auto inner_ctx = ctx.Indented();
@@ -318,14 +548,14 @@ namespace json {
                 inner_ctx.PrintIndent();
                 PrintNode(node, inner_ctx);
             }
-            out.put('\n');
+            out.Put('\n');
             ctx.PrintIndent();
-            out.put(']');
+            out.Put(']');
         }
 
         template <>
         void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
-            std::ostream& out = ctx.out;
+            io::OutputBuffer& out = ctx.out;
             out << "{\n"sv;
             bool first = true;
             auto inner_ctx = ctx.Indented();
@@ -337,13 +567,13 @@ namespace json {
                     out << ",\n"sv;
                 }
                 inner_ctx.PrintIndent();
-                PrintString(key, ctx.out);
+                detail::PrintString(ctx.out, key);
                 out << ": "sv;
                 PrintNode(node, inner_ctx);
             }
-            out.put('\n');
+            out.Put('\n');
             ctx.PrintIndent();
-            out.put('}');
+            out.Put('}');
         }
 
         void PrintNode(const Node& node, const PrintContext& ctx) {
@@ -356,10 +586,77 @@ namespace json {
     } // namespace
 
     Document Load(std::istream& input) {
-        return Document{LoadNode(input)};
+        memory::ScopedSubsystem subsystem(memory::Subsystem::JSON);
+        std::string data;
+        char chunk[1 << 16];
+        while (input.read(chunk, sizeof(chunk)) || input.gcount() > 0) {
+            data.append(chunk, static_cast<size_t>(input.gcount()));
+        }
+        return Load(data);
+    }
+
+    Document Load(std::string_view input) {
+        memory::ScopedSubsystem subsystem(memory::Subsystem::JSON);
+        InputBuffer buffer(input);
+        return Document{LoadNode(buffer)};
+    }
+
+    Document LoadDeferring(std::string_view input, std::string_view deferred_key, std::string_view& deferred_value) {
+        deferred_value = {};
+        memory::ScopedSubsystem subsystem(memory::Subsystem::JSON);
+        InputBuffer buffer(input);
+        char c = 0;
+        if (!buffer.ReadNonSpace(c) || c != '{') {
+            return Load(input);
+        }
+        return Document{LoadDict(buffer, deferred_key, &deferred_value)};
+    }
+
+    ArrayReader::ArrayReader(std::string_view array_json)
+        : data_(array_json) {
+        InputBuffer input(data_, false);
+        char c = 0;
+        if (!input.ReadNonSpace(c) || c != '[') {
+            throw ParsingError("Array is expected"s);
+        }
+        pos_ = input.Current() - data_.data();
+    }
+
+    std::optional<Node> ArrayReader::Next() {
+        if (finished_) {
+            return std::nullopt;
+        }
+        memory::ScopedSubsystem subsystem(memory::Subsystem::JSON);
+        // Разделители разбираются так же нестрого, как в LoadArray
+        InputBuffer input(data_.substr(pos_), false);
+        char c = 0;
+        if (!input.ReadNonSpace(c)) {
+            throw ParsingError("Array parsing error"s);
+        }
+        if (c == ']') {
+            finished_ = true;
+            pos_ += input.Current() - (data_.data() + pos_);
+            return std::nullopt;
+        }
+        if (c != ',') {
+            input.Putback();
+        }
+        Node element = LoadNode(input);
+        pos_ += input.Current() - (data_.data() + pos_);
+        return element;
     }
 
     void Print(const Document& doc, std::ostream& output) {
-        PrintNode(doc.GetRoot(), PrintContext{output});
+        io::OutputBuffer buffer(output);
+        PrintNode(doc.GetRoot(), PrintContext{buffer});
+        buffer.Flush();
+    }
+
+    namespace detail {
+        void PrintString(io::OutputBuffer& out, std::string_view value) {
+            out.Put('"');
+            out.WriteJsonEscaped(value);
+            out.Put('"');
+        }
     }
 } // namespace json
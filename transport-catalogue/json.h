@@ -2,10 +2,16 @@
 
 #include <iostream>
 #include <map>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
+namespace io {
+    class OutputBuffer;
+}
+
 namespace json {
     class Node;
     using Dict = std::map<std::string, Node>;
@@ -146,5 +152,35 @@ namespace json {
 
     Document Load(std::istream& input);
 
+    Document Load(std::string_view input);
+
+    // Как Load, но значение ключа deferred_key корневого словаря не разбирается: в документ оно
+    // не попадает, а его JSON-текст возвращается в deferred_value. Если ключа нет или корень
+    // не словарь, deferred_value остаётся пустым
+    Document LoadDeferring(std::string_view input, std::string_view deferred_key, std::string_view& deferred_value);
+
+    /*
+     * Разбирает JSON-массив по одному элементу, не держа в памяти весь массив.
+     * Текст массива должен жить, пока работает ArrayReader
+     */
+    class ArrayReader {
+    public:
+        // array_json начинается с '[' (возможно, после пробельных символов)
+        explicit ArrayReader(std::string_view array_json);
+
+        // Возвращает очередной элемент или std::nullopt после закрывающей скобки
+        std::optional<Node> Next();
+
+    private:
+        std::string_view data_;
+        size_t pos_ = 0;
+        bool finished_ = false;
+    };
+
     void Print(const Document& doc, std::ostream& output);
+
+    namespace detail {
+        // Выводит строку в кавычках, экранируя спецсимволы JSON
+        void PrintString(io::OutputBuffer& out, std::string_view value);
+    }
 } // namespace json
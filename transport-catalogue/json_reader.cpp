@@ -1,30 +1,117 @@
 #include "json_reader.h"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <map>
 #include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "bounded_queue.h"
+#include "latency_histogram.h"
+#include "memory_accounting.h"
+#include "thread_pool.h"
+#include "trace.h"
 
 namespace jsonreader {
+    namespace {
+        // Разбирает входной документ, замеряя время разбора
+        json::Document LoadInput(std::istream& input_stream) {
+            metrics::ScopedLatency latency(metrics::GetLatencyHistogram("phases"sv, "parse"sv));
+            tracing::Span span("json::Load"sv);
+            return json::Load(input_stream);
+        }
+    }
+
     void JSONReader::ReadInput(std::istream& input_stream) {
-        const json::Document inputed_json_document(std::move(json::Load(input_stream)));
+        const json::Document inputed_json_document = LoadInput(input_stream);
+        memory::RecordPhase("parse"sv);
         const json::Dict& requests = inputed_json_document.GetRoot().AsDict();
 
+        ProcessBaseDocument(requests);
+
+        const json::Array& stat_requests = requests.at("stat_requests"s).AsArray();
+        ProcessStatRequests(stat_requests);
+    }
+
+    void JSONReader::ReadBaseInput(std::istream& input_stream) {
+        const json::Document inputed_json_document = LoadInput(input_stream);
+        memory::RecordPhase("parse"sv);
+        ProcessBaseDocument(inputed_json_document.GetRoot().AsDict());
+    }
+
+    void JSONReader::ProcessBaseDocument(const json::Dict& requests) {
         const json::Array& base_requests = requests.at("base_requests"s).AsArray();
-        ProcessBaseRequests(base_requests);
+        {
+            metrics::ScopedLatency latency(metrics::GetLatencyHistogram("phases"sv, "base_ingestion"sv));
+            memory::ScopedSubsystem subsystem(memory::Subsystem::CATALOGUE);
+            ProcessBaseRequests(base_requests);
+        }
+        memory::RecordPhase("base_ingestion"sv);
 
         const json::Dict& render_settings = requests.at("render_settings"s).AsDict();
         ProcessRenderSettings(render_settings);
 
         const json::Dict& routing_settings = requests.at("routing_settings"s).AsDict();
         ProcessRoutingSettings(routing_settings);
+    }
 
-        const json::Array& stat_requests = requests.at("stat_requests"s).AsArray();
-        ProcessStatRequests(stat_requests);
+    std::shared_ptr<const renderer::MapRenderer> JSONReader::GetMapRenderer() const {
+        // Карта строится по снимку справочника и перестраивается, если справочник изменился
+        std::lock_guard lock(map_mutex_);
+        if (!map_renderer_ || map_catalogue_version_ != catalogue_.GetVersion()) {
+            ConstructMapRenderer();
+        }
+        return map_renderer_;
     }
 
-    const renderer::MapRenderer& JSONReader::GetMapRenderer() const {
-        return *map_renderer_;
+    bool JSONReader::IsRouterBuilt() const {
+        std::lock_guard lock(router_mutex_);
+        return router_ && router_catalogue_version_ == catalogue_.GetVersion();
+    }
+
+    std::shared_ptr<const transport::Router> JSONReader::GetRouter() const {
+        std::lock_guard lock(router_mutex_);
+        if (!router_ || router_catalogue_version_ != catalogue_.GetVersion()) {
+            metrics::ScopedLatency latency(metrics::GetLatencyHistogram("phases"sv, "router_build"sv));
+            tracing::Span span("JSONReader::GetRouter"sv);
+            memory::ScopedSubsystem subsystem(memory::Subsystem::ROUTER);
+            router_ = std::make_shared<transport::Router>(catalogue_, routing_settings_.value());
+            router_catalogue_version_ = catalogue_.GetVersion();
+            memory::RecordPhase("router_build"sv);
+        }
+        return router_;
+    }
+
+    requesthandler::EngineStats JSONReader::CollectEngineStats() const {
+        requesthandler::EngineStats stats;
+        for (size_t i = 1; i < StatRequest::TYPE_COUNT; ++i) {
+            const auto type = static_cast<StatRequest::Type>(i);
+            const RequestScheduler::TypeStats type_stats = scheduler_.GetTypeStats(type);
+            stats.requests.push_back({StatRequest::GetTypeName(type), type_stats.count,
+                                      type_stats.deadline_exceeded, type_stats.total_time});
+        }
+        std::sort(stats.requests.begin(), stats.requests.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.type < rhs.type;
+        });
+
+        // Запрос статистики не строит маршрутизатор
+        std::lock_guard lock(router_mutex_);
+        if (router_) {
+            stats.router = router_->GetStats();
+        }
+        return stats;
+    }
+
+    void JSONReader::BuildRouterAndMap() const {
+        GetRouter();
+        GetMapRenderer();
     }
 
     void JSONReader::ProcessBaseRequests(const json::Array& requests_array) const {
+        tracing::Span span("JSONReader::ProcessBaseRequests"sv);
         std::queue<std::pair<std::string, const json::Dict *>> distances_to_process;
         std::queue<const json::Dict *> buses_to_process;
         for (const json::Node& node : requests_array) {
@@ -93,46 +180,358 @@ namespace jsonreader {
     }
 
     void JSONReader::ProcessStatRequests(const json::Array& requests_array) const {
-        for (const json::Node& request_object : requests_array) {
-            if (request_object.AsDict().at("type"s) == "Stop"s) {
-                const std::string_view stop_name(request_object.AsDict().at("name"s).AsString());
-                const int request_id = request_object.AsDict().at("id"s).AsInt();
-                request_handler_.PrepareStop(request_id, stop_name);
-            }
-            else if (request_object.AsDict().at("type"s) == "Bus"s) {
-                const std::string_view bus_number(request_object.AsDict().at("name"s).AsString());
-                const int request_id = request_object.AsDict().at("id"s).AsInt();
-                request_handler_.PrepareBus(request_id, bus_number);
-            }
-            else if (request_object.AsDict().at("type"s) == "Map"s) {
-                const int request_id = request_object.AsDict().at("id"s).AsInt();
-                std::ostringstream output_stream;
-                map_renderer_->Render(output_stream);
-                request_handler_.PrepareMap(request_id, output_stream.str());
-            }
-            else if (request_object.AsDict().at("type"s) == "Route"s) {
-                const int request_id = request_object.AsDict().at("id"s).AsInt();
-                const std::string_view from_stop = request_object.AsDict().at("from"s).AsString();
-                const std::string_view to_stop = request_object.AsDict().at("to"s).AsString();
-
-                const std::optional<transport::Route> route_info = router_->PlotRoute(from_stop, to_stop);
-                if (route_info.has_value()) {
-                    request_handler_.PrepareRoute(request_id, route_info.value().total_time,
-                                                  route_info.value().route_items);
+        memory::ScopedSubsystem subsystem(memory::Subsystem::HANDLER);
+        std::vector<StatRequest> requests;
+        requests.reserve(requests_array.size());
+        {
+            tracing::Span span("JSONReader::DecodeStatRequests"sv);
+            for (const json::Node& request_object : requests_array) {
+                requests.push_back(DecodeStatRequest(request_object.AsDict()));
+            }
+        }
+
+        scheduler_.Run(requests, request_handler_, std::chrono::steady_clock::now());
+        memory::RecordPhase("stat_requests"sv);
+    }
+
+    JSONReader::PipelineStats JSONReader::ReadInputPipelined(std::istream& input_stream) {
+        const auto start = std::chrono::steady_clock::now();
+        std::string input;
+        char chunk[1 << 16];
+        while (input_stream.read(chunk, sizeof(chunk)) || input_stream.gcount() > 0) {
+            input.append(chunk, static_cast<size_t>(input_stream.gcount()));
+        }
+
+        // База разбирается целиком, а массив stat_requests откладывается и разбирается по элементам
+        std::string_view requests_json;
+        const json::Document base_document = [&] {
+            metrics::ScopedLatency latency(metrics::GetLatencyHistogram("phases"sv, "parse"sv));
+            tracing::Span span("json::LoadDeferring"sv);
+            return json::LoadDeferring(input, "stat_requests"sv, requests_json);
+        }();
+        memory::RecordPhase("parse"sv);
+        ProcessBaseDocument(base_document.GetRoot().AsDict());
+        if (requests_json.empty()) {
+            throw std::out_of_range("Input has no stat_requests"s);
+        }
+
+        PipelineStats stats;
+        ProcessStatRequestsPipelined(requests_json, stats, start);
+        stats.last_response = std::chrono::steady_clock::now() - start;
+        memory::RecordPhase("stat_requests"sv);
+        return stats;
+    }
+
+    void JSONReader::ProcessStatRequestsPipelined(std::string_view requests_json, PipelineStats& stats,
+                                                  std::chrono::steady_clock::time_point start) const {
+        // Запросы пакета ссылаются на строки в nodes, поэтому nodes не растёт после резервирования
+        struct PipelineBatch {
+            size_t sequence = 0;
+            std::chrono::steady_clock::time_point arrival;
+            std::vector<json::Node> nodes;
+            RequestScheduler::ResponseBatch responses;
+        };
+
+        json::ArrayReader reader(requests_json);
+        // Заполняет пакет; возвращает false, если массив закончился или не разобрался
+        const auto parse_batch = [&reader](PipelineBatch& batch) {
+            tracing::Span span("json::ArrayReader::Next"sv);
+            batch.arrival = std::chrono::steady_clock::now();
+            batch.nodes.reserve(PIPELINE_BATCH_SIZE);
+            try {
+                while (batch.nodes.size() < PIPELINE_BATCH_SIZE) {
+                    std::optional<json::Node> node = reader.Next();
+                    if (!node) {
+                        return false;
+                    }
+                    batch.nodes.push_back(std::move(*node));
+                }
+            }
+            catch (...) {
+                batch.responses.error = std::current_exception();
+                return false;
+            }
+            return true;
+        };
+
+        const auto execute_batch = [this](PipelineBatch& batch) {
+            memory::ScopedSubsystem subsystem(memory::Subsystem::HANDLER);
+            std::vector<StatRequest> requests;
+            requests.reserve(batch.nodes.size());
+            std::exception_ptr decode_error;
+            try {
+                tracing::Span span("JSONReader::DecodeStatRequests"sv);
+                for (const json::Node& node : batch.nodes) {
+                    requests.push_back(DecodeStatRequest(node.AsDict()));
+                }
+            }
+            catch (...) {
+                decode_error = std::current_exception();
+            }
+            // Ошибки упорядочены по позиции: ответ, затем разбор запроса, затем разбор массива после пакета
+            const std::exception_ptr parse_error = std::exchange(batch.responses.error, nullptr);
+            scheduler_.ExecuteRequests(requests.data(), requests.data() + requests.size(), request_handler_,
+                                       batch.responses, batch.arrival);
+            if (!batch.responses.error) {
+                batch.responses.error = decode_error ? decode_error : parse_error;
+            }
+        };
+
+        bool has_responses = false;
+        const auto write_batch = [&](const PipelineBatch& batch) {
+            stats.request_count += batch.responses.response_ends.size();
+            tracing::Span span("RequestScheduler::WriteResponses"sv);
+            memory::ScopedSubsystem subsystem(memory::Subsystem::HANDLER);
+            RequestScheduler::WriteResponses(batch.responses, request_handler_);
+            if (!has_responses && !batch.responses.responses.empty()) {
+                has_responses = true;
+                request_handler_.Flush();
+                stats.first_response = std::chrono::steady_clock::now() - start;
+            }
+        };
+
+        // На одном потоке стадии чередуются пакетами: вывод всё равно начинается до разбора всего массива
+        const size_t concurrency = threading::GetHardwareConcurrency();
+        if (concurrency <= 1) {
+            for (bool has_more = true; has_more;) {
+                PipelineBatch batch;
+                has_more = parse_batch(batch);
+                execute_batch(batch);
+                write_batch(batch);
+            }
+            return;
+        }
+
+        // Разбор идёт в отдельном потоке, ответы готовят concurrency - 1 исполнителей, а выводит
+        // их вызывающий поток. Конец работы стадия передаёт следующей пустыми указателями
+        const size_t executor_count = concurrency - 1;
+        threading::BoundedQueue<PipelineBatch*> parsed(PIPELINE_QUEUE_CAPACITY);
+        threading::BoundedQueue<PipelineBatch*> executed(PIPELINE_QUEUE_CAPACITY);
+        std::atomic<bool> stopping = false;
+
+        std::thread parser([&] {
+            tracing::SetThreadName("pipeline parser"s);
+            for (size_t sequence = 0; !stopping; ++sequence) {
+                auto batch = std::make_unique<PipelineBatch>();
+                batch->sequence = sequence;
+                const bool has_more = parse_batch(*batch);
+                parsed.Push(batch.release());
+                if (!has_more) {
+                    break;
+                }
+            }
+            for (size_t i = 0; i < executor_count; ++i) {
+                parsed.Push(nullptr);
+            }
+        });
+
+        std::vector<std::thread> executors;
+        executors.reserve(executor_count);
+        for (size_t i = 0; i < executor_count; ++i) {
+            executors.emplace_back([&] {
+                tracing::SetThreadName("pipeline executor"s);
+                while (PipelineBatch* batch = parsed.Pop()) {
+                    if (!stopping) {
+                        execute_batch(*batch);
+                    }
+                    executed.Push(batch);
+                }
+                executed.Push(nullptr);
+            });
+        }
+
+        // Пакеты приходят от исполнителей в произвольном порядке и ждут своей очереди в pending
+        std::map<size_t, std::unique_ptr<PipelineBatch>> pending;
+        size_t next_sequence = 0;
+        std::exception_ptr error;
+        for (size_t finished_executors = 0; finished_executors < executor_count;) {
+            PipelineBatch* batch = executed.Pop();
+            if (batch == nullptr) {
+                ++finished_executors;
+                continue;
+            }
+            pending.emplace(batch->sequence, batch);
+            for (auto it = pending.begin(); it != pending.end() && it->first == next_sequence;
+                 it = pending.erase(it), ++next_sequence) {
+                if (error) {
+                    continue;
+                }
+                try {
+                    write_batch(*it->second);
                 }
-                else {
-                    request_handler_.PrepareError(request_id, "not found"s);
+                catch (...) {
+                    // Остальные стадии доводят начатое до конца, не готовя новых ответов
+                    error = std::current_exception();
+                    stopping = true;
                 }
             }
         }
+
+        parser.join();
+        for (std::thread& executor : executors) {
+            executor.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
     }
 
-    renderer::SphereProjector JSONReader::GenerateSphereProjector(double width, double height, double padding) const {
-        std::vector<geo::Coordinates> coords;
-        for (const std::weak_ptr<transport::Stop> stop : catalogue_.GetAllStops()) {
-            if (!stop.lock()->passing_busses.empty()) {
-                coords.push_back(stop.lock()->coordinates);
+    bool JSONReader::ProcessStatRequest(const json::Dict& request,
+                                        requesthandler::RequestHandler& request_handler) const {
+        memory::ScopedSubsystem subsystem(memory::Subsystem::HANDLER);
+        return scheduler_.Execute(DecodeStatRequest(request), request_handler, std::chrono::steady_clock::now());
+    }
+
+    StatRequest JSONReader::DecodeStatRequest(const json::Dict& request) {
+        const json::Node* type = nullptr;
+        const json::Node* id = nullptr;
+        const json::Node* name = nullptr;
+        const json::Node* from = nullptr;
+        const json::Node* to = nullptr;
+        const json::Node* zoom = nullptr;
+        const json::Node* x = nullptr;
+        const json::Node* y = nullptr;
+        const json::Node* deadline = nullptr;
+        for (const auto& [key, value] : request) {
+            if (key == "type"sv) {
+                type = &value;
+            }
+            else if (key == "id"sv) {
+                id = &value;
+            }
+            else if (key == "name"sv) {
+                name = &value;
+            }
+            else if (key == "from"sv) {
+                from = &value;
+            }
+            else if (key == "to"sv) {
+                to = &value;
+            }
+            else if (key == "zoom"sv) {
+                zoom = &value;
+            }
+            else if (key == "x"sv) {
+                x = &value;
             }
+            else if (key == "y"sv) {
+                y = &value;
+            }
+            else if (key == "deadline_ms"sv) {
+                deadline = &value;
+            }
+        }
+
+        const auto required = [](const json::Node* field, std::string_view field_name) -> const json::Node& {
+            if (field == nullptr) {
+                throw std::out_of_range("Request has no field "s + std::string(field_name));
+            }
+            return *field;
+        };
+
+        StatRequest result;
+        const std::string& type_name = required(type, "type"sv).AsString();
+        if (type_name == "Stop"sv || type_name == "Bus"sv) {
+            result.type = type_name == "Stop"sv ? StatRequest::Type::STOP : StatRequest::Type::BUS;
+            result.name = required(name, "name"sv).AsString();
+        }
+        else if (type_name == "Route"sv) {
+            result.type = StatRequest::Type::ROUTE;
+            result.name = required(from, "from"sv).AsString();
+            result.to = required(to, "to"sv).AsString();
+        }
+        else if (type_name == "Map"sv) {
+            result.type = StatRequest::Type::MAP;
+        }
+        else if (type_name == "Memory"sv) {
+            result.type = StatRequest::Type::MEMORY;
+        }
+        else if (type_name == "Stats"sv) {
+            result.type = StatRequest::Type::STATS;
+        }
+        else if (type_name == "MapTile"sv) {
+            result.type = StatRequest::Type::MAP_TILE;
+            result.zoom = required(zoom, "zoom"sv).AsInt();
+            result.x = required(x, "x"sv).AsInt();
+            result.y = required(y, "y"sv).AsInt();
+        }
+        else {
+            return result;
+        }
+        result.id = required(id, "id"sv).AsInt();
+        if (deadline != nullptr) {
+            result.deadline_ms = deadline->AsInt();
+        }
+        return result;
+    }
+
+    bool JSONReader::ExecuteStatRequest(const StatRequest& request,
+                                        requesthandler::RequestHandler& request_handler) const {
+        const int request_id = request.id;
+        // Ответы на Stop, Bus и Route зависят только от аргументов запроса и запоминаются
+        switch (request.type) {
+        case StatRequest::Type::STOP:
+            request_handler.PrepareMemoized(requesthandler::ResponseCache::MakeKey('S', request.name), request_id,
+                                            [&](requesthandler::RequestHandler& handler) {
+                                                handler.PrepareStop(request_id, request.name);
+                                            });
+            return true;
+        case StatRequest::Type::BUS:
+            request_handler.PrepareMemoized(requesthandler::ResponseCache::MakeKey('B', request.name), request_id,
+                                            [&](requesthandler::RequestHandler& handler) {
+                                                handler.PrepareBus(request_id, request.name);
+                                            });
+            return true;
+        case StatRequest::Type::ROUTE:
+            request_handler.PrepareMemoized(
+                requesthandler::ResponseCache::MakeKey('R', request.name, request.to), request_id,
+                [&](requesthandler::RequestHandler& handler) {
+                    const std::optional<transport::Route> route_info = GetRouter()->PlotRoute(request.name, request.to);
+                    if (route_info.has_value()) {
+                        handler.PrepareRoute(request_id, route_info.value().total_time,
+                                             route_info.value().route_items);
+                    }
+                    else {
+                        handler.PrepareError(request_id, "not found"s);
+                    }
+                });
+            return true;
+        case StatRequest::Type::MAP: {
+            memory::ScopedSubsystem subsystem(memory::Subsystem::RENDERER);
+            const std::shared_ptr<const renderer::MapRenderer> map_renderer = GetMapRenderer();
+            request_handler.PrepareMap(request_id, *map_renderer->GetRenderedMapJson(), map_renderer->GetMapEncoding());
+            return true;
+        }
+        case StatRequest::Type::MAP_TILE: {
+            memory::ScopedSubsystem subsystem(memory::Subsystem::RENDERER);
+            const std::shared_ptr<const renderer::MapRenderer> map_renderer = GetMapRenderer();
+            const auto tile = map_renderer->GetRenderedTileJson(request.zoom, request.x, request.y);
+            if (tile) {
+                request_handler.PrepareMap(request_id, *tile, map_renderer->GetMapEncoding());
+            }
+            else {
+                request_handler.PrepareError(request_id, "not found"s);
+            }
+            return true;
+        }
+        case StatRequest::Type::MEMORY:
+            request_handler.PrepareMemory(request_id, memory::IsTrackingEnabled(), memory::GetStats());
+            return true;
+        case StatRequest::Type::STATS:
+            request_handler.PrepareStats(request_id, CollectEngineStats());
+            return true;
+        case StatRequest::Type::UNKNOWN:
+            break;
+        }
+        return false;
+    }
+
+    renderer::SphereProjector JSONReader::GenerateSphereProjector(const std::vector<const transport::Stop*>& stops,
+                                                                  double width, double height, double padding) {
+        std::vector<geo::Coordinates> coords;
+        coords.reserve(stops.size());
+        for (const transport::Stop* stop : stops) {
+            coords.push_back(stop->coordinates);
         }
         return {coords.begin(), coords.end(), width, height, padding};
     }
@@ -173,7 +572,7 @@ namespace jsonreader {
         return color_stream.str();
     }
 
-    void JSONReader::ConstructMapRenderer(const json::Dict& requests_array) {
+    renderer::RenderSettings JSONReader::ParseRenderSettings(const json::Dict& requests_array) {
         renderer::RenderSettings render_settings;
         render_settings.width = requests_array.at("width"s).AsDouble();
         render_settings.height = requests_array.at("height"s).AsDouble();
@@ -190,65 +589,61 @@ namespace jsonreader {
                     : GenerateColorStringFromArray(requests_array.at("underlayer_color"s).AsArray());
         render_settings.underlayer_width = requests_array.at("underlayer_width"s).AsDouble();
         render_settings.color_palette = GenerateColorPalette(requests_array.at("color_palette"s).AsArray());
-
-        renderer::SphereProjector projector(
-            GenerateSphereProjector(render_settings.width, render_settings.height, render_settings.padding));
-
-        map_renderer_ = std::make_shared<renderer::MapRenderer>(std::move(render_settings), projector);
+        if (const auto lod_tolerance = requests_array.find("lod_tolerance"s); lod_tolerance != requests_array.end()) {
+            render_settings.lod_tolerance = lod_tolerance->second.AsDouble();
+        }
+        if (const auto compression = requests_array.find("map_compression"s); compression != requests_array.end()) {
+            const std::string& value = compression->second.AsString();
+            if (value != "gzip"s && value != "none"s) {
+                throw std::invalid_argument("Unknown map_compression: "s + value);
+            }
+            render_settings.compress_map = value == "gzip"s;
+        }
+        return render_settings;
     }
 
-    std::vector<std::shared_ptr<transport::Bus>> JSONReader::GetSortedBusses() const {
-        std::vector<std::shared_ptr<transport::Bus>> sorted_busses = catalogue_.GetAllBusses();
-        std::sort(sorted_busses.begin(), sorted_busses.end(),
-                  [](const std::weak_ptr<transport::Bus>& lhs, const std::weak_ptr<transport::Bus>& rhs) {
-                      return lhs.lock()->number < rhs.lock()->number;
-                  });
-        return sorted_busses;
+    void JSONReader::ConstructMapRenderer() const {
+        metrics::ScopedLatency latency(metrics::GetLatencyHistogram("phases"sv, "render"sv));
+        tracing::Span span("JSONReader::ConstructMapRenderer"sv);
+        memory::ScopedSubsystem subsystem(memory::Subsystem::RENDERER);
+        // Проекция строится по остановкам карты, то есть по тем, через которые проходят маршруты
+        const renderer::RenderPlan& plan = GetRenderPlan();
+        const renderer::SphereProjector projector(GenerateSphereProjector(
+            plan.stops, render_settings_->width, render_settings_->height, render_settings_->padding));
+
+        map_renderer_ = std::make_shared<renderer::MapRenderer>(*render_settings_, projector);
+        map_catalogue_version_ = plan.catalogue_version;
+        map_renderer_->DrawMap(plan);
+        memory::RecordPhase("render"sv);
     }
 
-    std::vector<std::weak_ptr<transport::Stop>> JSONReader::GetSortedStops() const {
-        std::vector<std::weak_ptr<transport::Stop>> sorted_stops;
-        for (std::weak_ptr<transport::Stop> stop : catalogue_.GetAllStops()) {
-            if (!stop.lock()->passing_busses.empty()) {
-                sorted_stops.push_back(stop);
-            }
+    const renderer::RenderPlan& JSONReader::GetRenderPlan() const {
+        const size_t palette_size = render_settings_ ? render_settings_->color_palette.size() : 0;
+        if (!render_plan_ || render_plan_->catalogue_version != catalogue_.GetVersion()
+            || render_plan_->palette_size != palette_size) {
+            render_plan_ = std::make_shared<const renderer::RenderPlan>(
+                renderer::BuildRenderPlan(catalogue_, palette_size));
         }
-        std::sort(sorted_stops.begin(), sorted_stops.end(),
-                  [](const std::weak_ptr<transport::Stop>& lhs, const std::weak_ptr<transport::Stop>& rhs) {
-                      return lhs.lock()->name < rhs.lock()->name;
-                  });
-        return sorted_stops;
+        return *render_plan_;
     }
 
     void JSONReader::ProcessRenderSettings(const json::Dict& requests_array) {
-        ConstructMapRenderer(requests_array);
-
-        const std::vector sorted_busses = std::move(GetSortedBusses());
-
-        for (std::weak_ptr<transport::Bus> bus : sorted_busses) {
-            map_renderer_->AddBusToMap(*bus.lock());
-        }
-        map_renderer_->SetCurrentColor(0);
-
-        for (std::weak_ptr<transport::Bus> bus : sorted_busses) {
-            map_renderer_->AddBusNumberToMap(*bus.lock());
-        }
-        map_renderer_->SetCurrentColor(0);
-
-        const std::vector sorted_stops = std::move(GetSortedStops());
-        for (std::weak_ptr<transport::Stop> stop : sorted_stops) {
-            map_renderer_->DrawStopCircle(*stop.lock());
-        }
-
-        for (std::weak_ptr<transport::Stop> stop : sorted_stops) {
-            map_renderer_->DrawStopName(*stop.lock());
-        }
+        tracing::Span span("JSONReader::ProcessRenderSettings"sv);
+        render_settings_ = ParseRenderSettings(requests_array);
+        // Карта с прежними настройками больше не нужна, новая построится при первом запросе
+        std::lock_guard lock(map_mutex_);
+        map_renderer_.reset();
     }
 
     void JSONReader::ProcessRoutingSettings(const json::Dict& routing_settings) {
         const double bus_wait_time = routing_settings.at("bus_wait_time"s).AsDouble();
         const double bus_velocity = routing_settings.at("bus_velocity"s).AsDouble();
-        router_ =
-                std::make_unique<transport::Router>(catalogue_, transport::RouterSettings{bus_wait_time, bus_velocity});
+        routing_settings_ = transport::RouterSettings{bus_wait_time, bus_velocity};
+        {
+            std::lock_guard lock(router_mutex_);
+            router_.reset();
+        }
+        // Запомненные маршруты построены с прежними настройками
+        request_handler_.ClearResponseCache();
     }
 }
@@ -1,12 +1,20 @@
 #pragma once
 
+#include <chrono>
+#include <exception>
 #include <iomanip>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "request_handler.h"
+#include "request_scheduler.h"
 #include "json.h"
 #include "transport_router.h"
 
@@ -18,16 +26,90 @@ namespace jsonreader {
         JSONReader() = delete;
 
         explicit JSONReader(transport::Catalogue& catalogue, requesthandler::RequestHandler& request_handler)
-            : catalogue_(catalogue), request_handler_(request_handler) {}
+            : catalogue_(catalogue), request_handler_(request_handler),
+              scheduler_([this](const StatRequest& request, requesthandler::RequestHandler& handler) {
+                  return ExecuteStatRequest(request, handler);
+              }, [this](StatRequest::Type type) {
+                  // Первый запрос Route строит маршрутизатор, это дольше любого ответа
+                  return type == StatRequest::Type::ROUTE && !IsRouterBuilt();
+              }) {}
 
         void ReadInput(std::istream& input_stream);
-        const renderer::MapRenderer& GetMapRenderer() const;
+
+        // Время работы ReadInputPipelined, отсчитанное от начала чтения ввода
+        struct PipelineStats {
+            std::chrono::steady_clock::duration first_response{};
+            std::chrono::steady_clock::duration last_response{};
+            size_t request_count = 0;
+        };
+
+        // Как ReadInput, но stat_requests разбираются по мере обработки: поток разбора передаёт
+        // пакеты запросов потокам-исполнителям, а ответы выводятся в порядке запросов, как только
+        // готовы. Первый ответ сразу сбрасывается в поток вывода. Вывод совпадает с ReadInput
+        PipelineStats ReadInputPipelined(std::istream& input_stream);
+
+        // Загружает только базу: base_requests, render_settings и routing_settings.
+        // stat_requests, если они есть во входном документе, игнорируются
+        void ReadBaseInput(std::istream& input_stream);
+
+        // Отвечает на один запрос через переданный обработчик с учётом срока запроса.
+        // Возвращает false, если тип запроса неизвестен
+        bool ProcessStatRequest(const json::Dict& request, requesthandler::RequestHandler& request_handler) const;
+
+        // Разбирает запрос за один проход по его полям. Для неизвестного типа возвращает запрос
+        // с типом UNKNOWN, не проверяя остальные поля; при отсутствии нужного поля выбрасывает
+        // std::out_of_range
+        static StatRequest DecodeStatRequest(const json::Dict& request);
+
+        // Отвечает на запрос без учёта срока
+        bool ExecuteStatRequest(const StatRequest& request, requesthandler::RequestHandler& request_handler) const;
+
+        // Обработчик, с которым создан читатель. Обработчики подключений сервера строятся от него,
+        // чтобы делить его кэш ответов: ProcessRoutingSettings сбрасывает именно этот кэш
+        const requesthandler::RequestHandler& GetRequestHandler() const {
+            return request_handler_;
+        }
+
+        const RequestScheduler& GetScheduler() const {
+            return scheduler_;
+        }
+
+        // Карта и маршрутизатор строятся при первом обращении к ним и перестраиваются после
+        // изменения справочника. Оба метода потокобезопасны: построение идёт под блокировкой,
+        // а возвращённый объект живёт, пока им пользуются, даже если его уже заменило перестроение
+        std::shared_ptr<const renderer::MapRenderer> GetMapRenderer() const;
+
+        std::shared_ptr<const transport::Router> GetRouter() const;
+
+        // Строит карту и маршрутизатор заранее, чтобы первые запросы к ним не ждали построения
+        void BuildRouterAndMap() const;
+
+        // Счётчики планировщика и маршрутизатора для ответа на запрос Stats
+        requesthandler::EngineStats CollectEngineStats() const;
 
     private:
+        // Конвейер передаёт запросы пакетами по PIPELINE_BATCH_SIZE; в каждой очереди между
+        // стадиями помещается PIPELINE_QUEUE_CAPACITY пакетов
+        static constexpr size_t PIPELINE_BATCH_SIZE = 64;
+        static constexpr size_t PIPELINE_QUEUE_CAPACITY = 64;
+
         transport::Catalogue& catalogue_;
         requesthandler::RequestHandler& request_handler_;
-        std::shared_ptr<renderer::MapRenderer> map_renderer_;
-        std::unique_ptr<transport::Router> router_;
+        std::optional<renderer::RenderSettings> render_settings_;
+        mutable std::shared_ptr<const renderer::RenderPlan> render_plan_;
+        mutable std::shared_ptr<renderer::MapRenderer> map_renderer_;
+        mutable uint64_t map_catalogue_version_ = 0;
+        mutable std::mutex map_mutex_;
+        std::optional<transport::RouterSettings> routing_settings_;
+        mutable std::shared_ptr<transport::Router> router_;
+        mutable uint64_t router_catalogue_version_ = 0;
+        mutable std::mutex router_mutex_;
+        mutable RequestScheduler scheduler_;
+
+        // Построен ли маршрутизатор для текущего состояния справочника
+        bool IsRouterBuilt() const;
+
+        void ProcessBaseDocument(const json::Dict& requests);
 
         void ProcessBaseRequests(const json::Array& requests_array) const;
 
@@ -43,10 +125,14 @@ namespace jsonreader {
 
         void AddBusToCatalogue(const json::Dict& stop_object) const;
 
+        // Сначала разбирает все запросы пакета, затем отвечает на них через планировщик
         void ProcessStatRequests(const json::Array& requests_array) const;
 
-        [[nodiscard]] renderer::SphereProjector GenerateSphereProjector(double width, double height,
-                                                                        double padding) const;
+        void ProcessStatRequestsPipelined(std::string_view requests_json, PipelineStats& stats,
+                                          std::chrono::steady_clock::time_point start) const;
+
+        [[nodiscard]] static renderer::SphereProjector GenerateSphereProjector(
+            const std::vector<const transport::Stop*>& stops, double width, double height, double padding);
 
         static std::vector<std::string> GenerateColorPalette(const json::Array& color_array);
 
@@ -54,11 +140,13 @@ namespace jsonreader {
 
         static std::string GenerateColorStringFromArray(const json::Array& array);
 
-        void ConstructMapRenderer(const json::Dict& requests_array);
+        static renderer::RenderSettings ParseRenderSettings(const json::Dict& requests_array);
 
-        std::vector<std::shared_ptr<transport::Bus>> GetSortedBusses() const;
+        // Строит карту по текущему состоянию справочника
+        void ConstructMapRenderer() const;
 
-        std::vector<std::weak_ptr<transport::Stop>> GetSortedStops() const;
+        // План отрисовки для текущего состояния справочника; строится заново только после его изменения
+        const renderer::RenderPlan& GetRenderPlan() const;
 
         void ProcessRenderSettings(const json::Dict& requests_array);
 
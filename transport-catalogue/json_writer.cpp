@@ -0,0 +1,140 @@
+#include "json_writer.h"
+
+#include <stdexcept>
+
+namespace json {
+    Writer::Writer(io::OutputBuffer& output, Layout layout, size_t base_depth)
+        : out_(output), layout_(layout), base_depth_(base_depth) {}
+
+    Writer& Writer::Key(std::string_view key) {
+        if (frames_.empty() || !frames_.back().is_dict || key_specified_) {
+            throw std::logic_error("Key specified outside dictionary."s);
+        }
+        Frame& frame = frames_.back();
+        if (!frame.first) {
+            PrintSeparator();
+        }
+        frame.first = false;
+        PrintIndent(frames_.size());
+        detail::PrintString(out_, key);
+        out_ << (layout_ == Layout::PRETTY ? ": "sv : ":"sv);
+        key_specified_ = true;
+        return *this;
+    }
+
+    Writer& Writer::Value(std::nullptr_t) {
+        BeginValue();
+        out_ << "null"sv;
+        return *this;
+    }
+
+    Writer& Writer::Value(bool value) {
+        BeginValue();
+        out_ << (value ? "true"sv : "false"sv);
+        return *this;
+    }
+
+    Writer& Writer::Value(int value) {
+        BeginValue();
+        out_ << value;
+        return *this;
+    }
+
+    Writer& Writer::Value(int64_t value) {
+        BeginValue();
+        out_ << value;
+        return *this;
+    }
+
+    Writer& Writer::Value(double value) {
+        BeginValue();
+        out_ << value;
+        return *this;
+    }
+
+    Writer& Writer::Value(std::string_view value) {
+        BeginValue();
+        detail::PrintString(out_, value);
+        return *this;
+    }
+
+    Writer& Writer::RawValue(std::string_view json_fragment) {
+        BeginValue();
+        out_.Write(json_fragment);
+        return *this;
+    }
+
+    Writer& Writer::StartDict() {
+        StartContainer(true, '{');
+        return *this;
+    }
+
+    Writer& Writer::StartArray() {
+        StartContainer(false, '[');
+        return *this;
+    }
+
+    Writer& Writer::EndDict() {
+        EndContainer(true, '}');
+        return *this;
+    }
+
+    Writer& Writer::EndArray() {
+        EndContainer(false, ']');
+        return *this;
+    }
+
+    void Writer::Flush() {
+        out_.Flush();
+    }
+
+    void Writer::BeginValue() {
+        if (frames_.empty()) {
+            return;
+        }
+        Frame& frame = frames_.back();
+        if (frame.is_dict) {
+            if (!key_specified_) {
+                throw std::logic_error("Key is not specified"s);
+            }
+            key_specified_ = false;
+            return;
+        }
+        if (!frame.first) {
+            PrintSeparator();
+        }
+        frame.first = false;
+        PrintIndent(frames_.size());
+    }
+
+    void Writer::StartContainer(bool is_dict, char open_bracket) {
+        BeginValue();
+        out_.Put(open_bracket);
+        if (layout_ == Layout::PRETTY) {
+            out_.Put('\n');
+        }
+        frames_.push_back({is_dict});
+    }
+
+    void Writer::EndContainer(bool is_dict, char close_bracket) {
+        if (frames_.empty() || frames_.back().is_dict != is_dict || key_specified_) {
+            throw std::logic_error("Trying to end a container that is not open."s);
+        }
+        frames_.pop_back();
+        if (layout_ == Layout::PRETTY) {
+            out_.Put('\n');
+            PrintIndent(frames_.size());
+        }
+        out_.Put(close_bracket);
+    }
+
+    void Writer::PrintIndent(size_t depth) {
+        if (layout_ == Layout::PRETTY) {
+            out_.WriteRepeated(' ', (base_depth_ + depth) * INDENT_STEP);
+        }
+    }
+
+    void Writer::PrintSeparator() {
+        out_ << (layout_ == Layout::PRETTY ? ",\n"sv : ","sv);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "json.h"
+#include "output_buffer.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace json {
+    using namespace std::literals;
+
+    /*
+     * Потоковый писатель JSON. В отличие от Builder, не строит дерево Node,
+     * а сразу выводит значения в буфер в том же формате, что и json::Print.
+     * Ключи словарей выводятся в порядке вызова Key, поэтому для совпадения
+     * с json::Print их нужно передавать в лексикографическом порядке.
+     * В компактном режиме значения выводятся в одну строку без отступов.
+     */
+    class Writer {
+    public:
+        enum class Layout {
+            PRETTY,
+            COMPACT,
+        };
+
+        // base_depth - глубина вложенности, на которой окажется выводимое значение. Позволяет
+        // вывести элемент отдельно, а затем вставить его в массив через RawValue без изменений
+        explicit Writer(io::OutputBuffer& output, Layout layout = Layout::PRETTY, size_t base_depth = 0);
+
+        Writer(const Writer&) = delete;
+
+        Writer& operator=(const Writer&) = delete;
+
+        Writer& Key(std::string_view key);
+
+        Writer& Value(std::nullptr_t);
+
+        Writer& Value(bool value);
+
+        Writer& Value(int value);
+
+        // Счётчики и размеры, которые не помещаются в int
+        Writer& Value(int64_t value);
+
+        Writer& Value(double value);
+
+        Writer& Value(std::string_view value);
+
+        Writer& Value(const char* value) {
+            return Value(std::string_view(value));
+        }
+
+        // Вставляет готовый JSON-фрагмент как значение, не изменяя его
+        Writer& RawValue(std::string_view json_fragment);
+
+        Writer& StartDict();
+
+        Writer& StartArray();
+
+        Writer& EndDict();
+
+        Writer& EndArray();
+
+        // Сбрасывает накопленный вывод в поток буфера
+        void Flush();
+
+    private:
+        struct Frame {
+            bool is_dict;
+            bool first = true;
+        };
+
+        io::OutputBuffer& out_;
+        Layout layout_;
+        size_t base_depth_;
+        std::vector<Frame> frames_;
+        bool key_specified_ = false;
+        static constexpr int INDENT_STEP = 4;
+
+        void BeginValue();
+
+        void StartContainer(bool is_dict, char open_bracket);
+
+        void EndContainer(bool is_dict, char close_bracket);
+
+        void PrintIndent(size_t depth);
+
+        void PrintSeparator();
+    };
+}
@@ -0,0 +1,179 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "json_writer.h"
+#include "output_buffer.h"
+
+namespace metrics {
+    using namespace std::literals;
+
+    void LatencyHistogram::Record(Duration latency) {
+        const uint64_t value = static_cast<uint64_t>(std::max(latency.count(), Duration::rep{0}));
+        buckets_[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        total_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t LatencyHistogram::GetCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    LatencyHistogram::Duration LatencyHistogram::GetMax() const {
+        return Duration(max_.load(std::memory_order_relaxed));
+    }
+
+    LatencyHistogram::Duration LatencyHistogram::GetMean() const {
+        const uint64_t count = GetCount();
+        return count == 0 ? Duration{} : Duration(total_.load(std::memory_order_relaxed) / count);
+    }
+
+    LatencyHistogram::Duration LatencyHistogram::GetPercentile(double quantile) const {
+        const uint64_t count = GetCount();
+        if (count == 0) {
+            return Duration{};
+        }
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(count))));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(Duration(GetBucketUpperBound(i)), GetMax());
+            }
+        }
+        return GetMax();
+    }
+
+    size_t LatencyHistogram::GetBucketIndex(uint64_t value) {
+        value = std::min(value, (uint64_t{1} << MAX_VALUE_BITS) - 1);
+        if (value < SUB_BUCKET_COUNT) {
+            return value;
+        }
+        // Номер интервала [2^k, 2^(k+1)) считается от k = SUB_BUCKET_BITS; в интервале shift младших
+        // битов значения отбрасываются, старшие SUB_BUCKET_BITS задают часть интервала
+        const unsigned shift = static_cast<unsigned>(std::bit_width(value)) - 1 - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) - SUB_BUCKET_COUNT);
+    }
+
+    uint64_t LatencyHistogram::GetBucketUpperBound(size_t index) {
+        if (index < SUB_BUCKET_COUNT) {
+            return index;
+        }
+        const uint64_t shift = index / SUB_BUCKET_COUNT - 1;
+        const uint64_t lower_bound = (SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT) << shift;
+        return lower_bound + (uint64_t{1} << shift) - 1;
+    }
+
+    namespace {
+        // Гистограммы процесса. Отчёт выводится из деструктора, то есть при завершении программы
+        class LatencyRegistry {
+        public:
+            LatencyRegistry() {
+                if (const char* destination = std::getenv("TC_LATENCY_REPORT");
+                    destination != nullptr && *destination != '\0') {
+                    destination_ = destination;
+                }
+            }
+
+            LatencyRegistry(const LatencyRegistry&) = delete;
+
+            LatencyRegistry& operator=(const LatencyRegistry&) = delete;
+
+            ~LatencyRegistry() {
+                if (destination_ == "-"s) {
+                    WriteReport(std::cerr);
+                }
+                else if (!destination_.empty()) {
+                    std::ofstream output(destination_);
+                    WriteReport(output);
+                }
+            }
+
+            bool IsEnabled() const {
+                return !destination_.empty();
+            }
+
+            LatencyHistogram& GetHistogram(std::string_view group, std::string_view name) {
+                std::lock_guard lock(mutex_);
+                auto& histogram = histograms_[std::pair(std::string(group), std::string(name))];
+                if (!histogram) {
+                    histogram = std::make_unique<LatencyHistogram>();
+                }
+                return *histogram;
+            }
+
+            void WriteReport(std::ostream& output) {
+                std::lock_guard lock(mutex_);
+                io::OutputBuffer buffer(output);
+                json::Writer writer(buffer);
+                const auto to_microseconds = [](LatencyHistogram::Duration duration) {
+                    return std::chrono::duration<double, std::micro>(duration).count();
+                };
+
+                writer.StartDict();
+                std::string_view current_group;
+                bool has_group = false;
+                for (const auto& [key, histogram] : histograms_) {
+                    if (!has_group || key.first != current_group) {
+                        if (has_group) {
+                            writer.EndDict();
+                        }
+                        current_group = key.first;
+                        has_group = true;
+                        writer.Key(current_group).StartDict();
+                    }
+                    writer.Key(key.second).StartDict()
+                          .Key("count"sv).Value(static_cast<int64_t>(histogram->GetCount()))
+                          .Key("max_us"sv).Value(to_microseconds(histogram->GetMax()))
+                          .Key("mean_us"sv).Value(to_microseconds(histogram->GetMean()))
+                          .Key("p50_us"sv).Value(to_microseconds(histogram->GetPercentile(0.5)))
+                          .Key("p99_us"sv).Value(to_microseconds(histogram->GetPercentile(0.99)))
+                          .Key("p999_us"sv).Value(to_microseconds(histogram->GetPercentile(0.999)))
+                          .EndDict();
+                }
+                if (has_group) {
+                    writer.EndDict();
+                }
+                writer.EndDict();
+                buffer.Put('\n');
+                buffer.Flush();
+            }
+
+        private:
+            std::string destination_;
+            std::mutex mutex_;
+            std::map<std::pair<std::string, std::string>, std::unique_ptr<LatencyHistogram>> histograms_;
+        };
+
+        LatencyRegistry& GetRegistry() {
+            static LatencyRegistry registry;
+            return registry;
+        }
+    }
+
+    bool IsLatencyReportEnabled() {
+        return GetRegistry().IsEnabled();
+    }
+
+    LatencyHistogram* GetLatencyHistogram(std::string_view group, std::string_view name) {
+        LatencyRegistry& registry = GetRegistry();
+        return registry.IsEnabled() ? &registry.GetHistogram(group, name) : nullptr;
+    }
+
+    void WriteLatencyReport(std::ostream& output) {
+        GetRegistry().WriteReport(output);
+    }
+}
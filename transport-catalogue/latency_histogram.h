@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+namespace metrics {
+    /*
+     * Гистограмма задержек в духе HdrHistogram: каждый интервал [2^k, 2^(k+1)) наносекунд
+     * делится на SUB_BUCKET_COUNT равных частей, поэтому перцентили считаются с относительной
+     * погрешностью меньше 1% при любом масштабе, от наносекунд до часов.
+     * Запись - несколько атомарных инкрементов, её можно вести из любых потоков
+     */
+    class LatencyHistogram {
+    public:
+        using Duration = std::chrono::nanoseconds;
+
+        void Record(Duration latency);
+
+        uint64_t GetCount() const;
+
+        Duration GetMax() const;
+
+        Duration GetMean() const;
+
+        // Значение, не меньше которого quantile (от 0 до 1) всех записанных задержек
+        Duration GetPercentile(double quantile) const;
+
+    private:
+        static constexpr unsigned SUB_BUCKET_BITS = 7;
+        static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{1} << SUB_BUCKET_BITS;
+        // Задержки от 2^MAX_VALUE_BITS нс (около 5 часов) попадают в последнюю ячейку
+        static constexpr unsigned MAX_VALUE_BITS = 44;
+        static constexpr size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+        std::atomic<uint64_t> count_ = 0;
+        std::atomic<uint64_t> total_ = 0;
+        std::atomic<uint64_t> max_ = 0;
+
+        static size_t GetBucketIndex(uint64_t value);
+
+        // Наибольшее значение, попадающее в ячейку
+        static uint64_t GetBucketUpperBound(size_t index);
+    };
+
+    // Замеры включаются переменной окружения TC_LATENCY_REPORT: "-" - отчёт в stderr,
+    // иначе путь к файлу отчёта. Отчёт выводится при завершении программы
+    bool IsLatencyReportEnabled();
+
+    // Гистограмма name из группы group ("phases" - этапы запуска, "requests" - типы запросов).
+    // Если замеры выключены, возвращает nullptr
+    LatencyHistogram* GetLatencyHistogram(std::string_view group, std::string_view name);
+
+    // Выводит все гистограммы JSON-словарём: группа -> имя -> число замеров и перцентили в микросекундах
+    void WriteLatencyReport(std::ostream& output);
+
+    // Записывает в гистограмму время своей жизни; с nullptr ничего не делает
+    class ScopedLatency {
+    public:
+        explicit ScopedLatency(LatencyHistogram* histogram)
+            : histogram_(histogram) {
+            if (histogram_ != nullptr) {
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+
+        ScopedLatency(const ScopedLatency&) = delete;
+
+        ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+        ~ScopedLatency() {
+            if (histogram_ != nullptr) {
+                histogram_->Record(std::chrono::steady_clock::now() - start_);
+            }
+        }
+
+    private:
+        LatencyHistogram* histogram_;
+        std::chrono::steady_clock::time_point start_;
+    };
+}
@@ -1,11 +1,87 @@
+#include <chrono>
+#include <fstream>
+#include <string_view>
+
 #include "transport_catalogue.h"
 #include "json_reader.h"
+#include "server.h"
+#include "trace.h"
+
+using namespace std::literals;
+
+namespace {
+    int PrintUsage(std::string_view program) {
+        std::cerr << "Usage: "sv << program << " [--pipeline]"sv << '\n'
+                  << "       "sv << program << " --serve <base.json> [--socket <path>]"sv << std::endl;
+        return 1;
+    }
+
+    // Конвейерная обработка пакета; время до первого и последнего ответа выводится в stderr
+    int RunPipelined() {
+        std::ios::sync_with_stdio(false);
+        transport::Catalogue catalogue;
+        requesthandler::RequestHandler handler(catalogue, std::cout);
+        jsonreader::JSONReader reader(catalogue, handler);
+
+        const jsonreader::JSONReader::PipelineStats stats = reader.ReadInputPipelined(std::cin);
+        handler.Finish();
+
+        using Milliseconds = std::chrono::duration<double, std::milli>;
+        std::cerr << "requests: "sv << stats.request_count
+                  << ", first response: "sv << Milliseconds(stats.first_response).count() << " ms"sv
+                  << ", last response: "sv << Milliseconds(stats.last_response).count() << " ms"sv << std::endl;
+        return 0;
+    }
+
+    // Режим сервера: база читается из файла, запросы - построчно из stdin или Unix-сокета
+    int Serve(std::string_view base_path, std::string_view socket_path) {
+        std::ifstream base_input{std::string(base_path)};
+        if (!base_input) {
+            std::cerr << "Can't open "sv << base_path << std::endl;
+            return 1;
+        }
+
+        transport::Catalogue catalogue;
+        // Сам обработчик ничего не выводит: он хранит общий кэш ответов,
+        // а обработчики подключений строятся от него (см. server::ServeStream)
+        requesthandler::RequestHandler shared_handler(catalogue, std::cout, requesthandler::OutputMode::LINES);
+        jsonreader::JSONReader reader(catalogue, shared_handler);
+        reader.ReadBaseInput(base_input);
+        // Сервер готовит всё при запуске, чтобы первые запросы Route и Map не ждали построения
+        reader.BuildRouterAndMap();
+
+        if (socket_path.empty()) {
+            std::ios::sync_with_stdio(false);
+            server::ServeStream(reader, std::cin, std::cout);
+        }
+        else {
+            server::ServeUnixSocket(reader, std::string(socket_path));
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    tracing::SetThreadName("main"s);
+    if (argc == 1) {
+        transport::Catalogue catalogue;
+        requesthandler::RequestHandler handler(catalogue, std::cout);
+        jsonreader::JSONReader reader(catalogue, handler);
 
-int main() {
-    transport::Catalogue catalogue;
-    requesthandler::RequestHandler handler(catalogue);
-    jsonreader::JSONReader reader(catalogue, handler);
+        reader.ReadInput(std::cin);
+        handler.Finish();
+        return 0;
+    }
 
-    reader.ReadInput(std::cin);
-    Print(handler.GetDocument(), std::cout);
+    const std::string_view mode(argv[1]);
+    if (mode == "--pipeline"sv && argc == 2) {
+        return RunPipelined();
+    }
+    if (mode == "--serve"sv && argc == 3) {
+        return Serve(argv[2], {});
+    }
+    if (mode == "--serve"sv && argc == 5 && argv[3] == "--socket"sv) {
+        return Serve(argv[2], argv[4]);
+    }
+    return PrintUsage(argv[0]);
 }
@@ -1,6 +1,121 @@
 #include "map_renderer.h"
 
+#include <algorithm>
+#include <cmath>
+
+#include "gzip_stream.h"
+#include "thread_pool.h"
+
 namespace renderer {
+    namespace {
+        constexpr int MAX_TILE_ZOOM = 20;
+        constexpr size_t MAX_CACHED_TILES = 4096;
+
+        // Число маршрутов или остановок в одной части слоя при параллельном построении карты
+        constexpr size_t ITEMS_PER_DRAW_PART = 256;
+
+        double GetDistance(svg::Point lhs, svg::Point rhs) {
+            return std::hypot(lhs.x - rhs.x, lhs.y - rhs.y);
+        }
+
+        // Расстояние от точки до отрезка [begin, end]
+        double GetDistanceToSegment(svg::Point point, svg::Point begin, svg::Point end) {
+            const double dx = end.x - begin.x;
+            const double dy = end.y - begin.y;
+            const double length_squared = dx * dx + dy * dy;
+            if (IsZero(length_squared)) {
+                return GetDistance(point, begin);
+            }
+            const double t = std::clamp(((point.x - begin.x) * dx + (point.y - begin.y) * dy) / length_squared, 0., 1.);
+            return GetDistance(point, {begin.x + t * dx, begin.y + t * dy});
+        }
+    }
+
+    std::vector<svg::Point> SimplifyPolyline(const std::vector<svg::Point>& points, double tolerance) {
+        if (points.size() <= 2) {
+            return points;
+        }
+
+        // Сначала сливаются точки, проецирующиеся в один пиксель
+        const double merge_distance = std::min(tolerance, 1.);
+        std::vector<svg::Point> merged = points;
+        size_t merged_count = 1;
+        for (size_t i = 1; i + 1 < points.size(); ++i) {
+            if (GetDistance(points[i], merged[merged_count - 1]) >= merge_distance) {
+                merged[merged_count++] = points[i];
+            }
+        }
+        merged[merged_count++] = points.back();
+        merged.resize(merged_count);
+
+        // Дуглас-Пекер без рекурсии: стек ещё не разобранных участков
+        std::vector<bool> keep(merged.size(), false);
+        keep.front() = keep.back() = true;
+        std::vector<std::pair<size_t, size_t>> ranges{{0, merged.size() - 1}};
+        while (!ranges.empty()) {
+            const auto [first, last] = ranges.back();
+            ranges.pop_back();
+            double max_distance = 0;
+            size_t farthest = first;
+            for (size_t i = first + 1; i < last; ++i) {
+                const double distance = GetDistanceToSegment(merged[i], merged[first], merged[last]);
+                if (distance > max_distance) {
+                    max_distance = distance;
+                    farthest = i;
+                }
+            }
+            if (max_distance > tolerance) {
+                keep[farthest] = true;
+                ranges.emplace_back(first, farthest);
+                ranges.emplace_back(farthest, last);
+            }
+        }
+
+        std::vector<svg::Point> result;
+        for (size_t i = 0; i < merged.size(); ++i) {
+            if (keep[i]) {
+                result.push_back(merged[i]);
+            }
+        }
+        return result;
+    }
+
+    RenderPlan BuildRenderPlan(const transport::Catalogue& catalogue, size_t palette_size) {
+        RenderPlan plan;
+        plan.catalogue_version = catalogue.GetVersion();
+        plan.palette_size = palette_size;
+
+        const auto& all_busses = catalogue.GetAllBusses();
+        plan.buses.reserve(all_busses.size());
+        for (const std::shared_ptr<transport::Bus>& bus : all_busses) {
+            plan.buses.push_back({bus.get()});
+        }
+        std::sort(plan.buses.begin(), plan.buses.end(),
+                  [](const RenderPlan::BusEntry& lhs, const RenderPlan::BusEntry& rhs) {
+                      return lhs.bus->number < rhs.bus->number;
+                  });
+        for (size_t i = 0; i < plan.buses.size(); ++i) {
+            RenderPlan::BusEntry& entry = plan.buses[i];
+            entry.color_index = palette_size == 0 ? 0 : i % palette_size;
+            const transport::Bus& bus = *entry.bus;
+            entry.first_label_stop = bus.stops.front().lock().get();
+            const transport::Stop* last_stop = bus.stops.back().lock().get();
+            if (!bus.is_circular && last_stop != entry.first_label_stop) {
+                entry.last_label_stop = last_stop;
+            }
+        }
+
+        for (const std::shared_ptr<transport::Stop>& stop : catalogue.GetAllStops()) {
+            if (!stop->passing_busses.empty()) {
+                plan.stops.push_back(stop.get());
+            }
+        }
+        std::sort(plan.stops.begin(), plan.stops.end(), [](const transport::Stop* lhs, const transport::Stop* rhs) {
+            return lhs->name < rhs->name;
+        });
+        return plan;
+    }
+
     MapRenderer::MapRenderer(RenderSettings settings, const SphereProjector& projector): settings_(std::move(settings)),
         projector_(projector) {}
 
@@ -8,88 +123,258 @@ namespace renderer {
         map_.Render(out_stream);
     }
 
-    void MapRenderer::AddBusToMap(const transport::Bus& bus) {
-        const std::string bus_color = PickColor();
-        DrawBusLine(bus, bus_color);
+    void MapRenderer::Render(io::OutputBuffer& out) const {
+        map_.Render(out);
     }
 
-    void MapRenderer::AddBusNumberAtStop(const std::string& text, geo::Coordinates coordinates,
-                                           const std::string& color) {
-        svg::Text basic_text;
-        basic_text.SetData(text).SetPosition(projector_(coordinates)).SetOffset(settings_.bus_label_offset)
-                  .SetFontFamily("Verdana"s).SetFontWeight("bold"s).SetFontSize(settings_.bus_label_font_size);
+    std::shared_ptr<const std::string> MapRenderer::GetRenderedMapJson() const {
+        std::lock_guard lock(cache_mutex_);
+        if (!rendered_map_json_) {
+            rendered_map_json_ = RenderJsonString([this](io::OutputBuffer& out) { map_.Render(out); });
+        }
+        return rendered_map_json_;
+    }
 
-        svg::Text substrate = basic_text;
-        substrate.SetFillColor(settings_.underlayer_color)
-                 .SetStrokeColor(settings_.underlayer_color).SetStrokeWidth(settings_.underlayer_width)
-                 .SetStrokeLineCap(svg::StrokeLineCap::ROUND).SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    std::string_view MapRenderer::GetMapEncoding() const {
+        return settings_.compress_map ? "gzip+base64"sv : std::string_view{};
+    }
 
-        svg::Text bus_number = basic_text;
-        bus_number.SetFillColor(color);
+    std::shared_ptr<const std::string> MapRenderer::RenderJsonString(
+        const std::function<void(io::OutputBuffer&)>& render) const {
+        if (!settings_.compress_map) {
+            // SVG сразу выводится в экранированном виде, без промежуточной копии
+            io::OutputBuffer buffer;
+            buffer.Put('"');
+            buffer.SetJsonEscaping(true);
+            render(buffer);
+            buffer.SetJsonEscaping(false);
+            buffer.Put('"');
+            return std::make_shared<const std::string>(buffer.Take());
+        }
 
-        map_.Add(substrate);
-        map_.Add(bus_number);
+        // SVG сжимается блоками по мере вывода; в памяти остаётся только результат в base64,
+        // которому экранирование не нужно
+        std::string result = "\""s;
+        io::GzipBase64Streambuf gzip(result, Z_BEST_SPEED);
+        {
+            std::ostream gzip_stream(&gzip);
+            io::OutputBuffer buffer(gzip_stream);
+            render(buffer);
+        }
+        gzip.Finish();
+        result.push_back('"');
+        return std::make_shared<const std::string>(std::move(result));
     }
 
-    void MapRenderer::AddBusNumberToMap(const transport::Bus& bus) {
-        const std::string color = PickColor();
+    std::shared_ptr<const std::string> MapRenderer::GetRenderedTileJson(int zoom, int x, int y) const {
+        if (zoom < 0 || zoom > MAX_TILE_ZOOM) {
+            return nullptr;
+        }
+        const int tiles_per_side = 1 << zoom;
+        if (x < 0 || x >= tiles_per_side || y < 0 || y >= tiles_per_side) {
+            return nullptr;
+        }
 
-        AddBusNumberAtStop(bus.number, bus.stops.front().lock()->coordinates, color);
+        const uint64_t key = (static_cast<uint64_t>(zoom) << 48) | (static_cast<uint64_t>(x) << 24)
+                             | static_cast<uint64_t>(y);
+        const svg::SpatialIndex* spatial_index = nullptr;
+        {
+            std::lock_guard lock(cache_mutex_);
+            if (const auto it = rendered_tiles_.find(key); it != rendered_tiles_.end()) {
+                return it->second;
+            }
+            if (!spatial_index_) {
+                spatial_index_ = std::make_unique<svg::SpatialIndex>(map_);
+            }
+            spatial_index = spatial_index_.get();
+        }
 
-        if (!bus.is_circular && bus.stops.front().lock().get() != bus.stops.back().lock().get()) {
-            AddBusNumberAtStop(bus.number, bus.stops.back().lock()->coordinates, color);
+        // Плитка отрисовывается без блокировки; если её одновременно отрисуют два потока,
+        // в кэше останется первый результат
+        const double tile_width = settings_.width / tiles_per_side;
+        const double tile_height = settings_.height / tiles_per_side;
+        const svg::Rect tile{x * tile_width, y * tile_height, (x + 1) * tile_width, (y + 1) * tile_height};
+        const std::vector<uint32_t> objects = spatial_index->Query(tile);
+        auto rendered_tile = RenderJsonString([&](io::OutputBuffer& out) { map_.Render(out, objects, tile); });
+
+        std::lock_guard lock(cache_mutex_);
+        if (rendered_tiles_.size() >= MAX_CACHED_TILES) {
+            rendered_tiles_.clear();
         }
+        return rendered_tiles_.emplace(key, std::move(rendered_tile)).first->second;
+    }
+
+    void MapRenderer::InvalidateRenderedMap() {
+        std::lock_guard lock(cache_mutex_);
+        rendered_map_json_.reset();
+        spatial_index_.reset();
+        rendered_tiles_.clear();
     }
 
-    void MapRenderer::SetCurrentColor(const size_t color_number) {
-        current_color_ = color_number;
+    void MapRenderer::DrawMap(const RenderPlan& plan) {
+        ProjectStops(plan.stops);
+
+        std::vector<LayerPart> parts;
+        for (const Layer layer : {Layer::BUS_LINES, Layer::BUS_LABELS, Layer::STOP_CIRCLES, Layer::STOP_NAMES}) {
+            const bool is_bus_layer = layer == Layer::BUS_LINES || layer == Layer::BUS_LABELS;
+            const size_t item_count = is_bus_layer ? plan.buses.size() : plan.stops.size();
+            for (size_t begin = 0; begin < item_count; begin += ITEMS_PER_DRAW_PART) {
+                parts.push_back({layer, begin, std::min(begin + ITEMS_PER_DRAW_PART, item_count)});
+            }
+        }
+
+        if (threading::GetHardwareConcurrency() <= 1 || parts.size() <= 1) {
+            for (const LayerPart& part : parts) {
+                DrawLayerPart(map_, part, plan);
+            }
+        }
+        else {
+            std::vector<svg::Document> documents(parts.size());
+            threading::ParallelFor(parts.size(), [&](size_t i) {
+                DrawLayerPart(documents[i], parts[i], plan);
+            });
+            for (svg::Document& document : documents) {
+                map_.Append(std::move(document));
+            }
+        }
+        InvalidateRenderedMap();
     }
 
-    void MapRenderer::DrawStopCircle(const transport::Stop& stop) {
-        svg::Circle circle;
-        circle.SetCenter(projector_(stop.coordinates)).SetRadius(settings_.stop_radius).SetFillColor("white"s);
-        map_.Add(circle);
+    void MapRenderer::ProjectStops(const std::vector<const transport::Stop*>& stops) {
+        size_t table_size = 0;
+        for (const transport::Stop* stop : stops) {
+            table_size = std::max(table_size, stop->index + 1);
+        }
+        std::vector<geo::Coordinates> coordinates(table_size, geo::Coordinates{0, 0});
+        for (const transport::Stop* stop : stops) {
+            coordinates[stop->index] = stop->coordinates;
+        }
+        stop_points_ = projector_.Project(coordinates);
     }
 
-    void MapRenderer::DrawStopName(const transport::Stop& stop) {
-        svg::Text basic_text;
-        basic_text.SetData(stop.name).SetPosition(projector_(stop.coordinates)).SetOffset(settings_.stop_label_offset)
-                  .SetFontSize(settings_.stop_label_font_size).SetFontFamily("Verdana"s);
+    MapRenderer::LayerStyles MapRenderer::InternLayerStyles(svg::Document& document, Layer layer) const {
+        svg::PathStyle underlayer;
+        underlayer.fill_color = settings_.underlayer_color;
+        underlayer.stroke_color = settings_.underlayer_color;
+        underlayer.stroke_width = settings_.underlayer_width;
+        underlayer.stroke_line_cap = svg::StrokeLineCap::ROUND;
+        underlayer.stroke_line_join = svg::StrokeLineJoin::ROUND;
 
-        svg::Text substrate = basic_text;
-        substrate.SetFillColor(settings_.underlayer_color)
-                 .SetStrokeColor(settings_.underlayer_color).SetStrokeWidth(settings_.underlayer_width)
-                 .SetStrokeLineCap(svg::StrokeLineCap::ROUND).SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+        LayerStyles styles;
+        switch (layer) {
+        case Layer::BUS_LINES:
+            for (const std::string& color : settings_.color_palette) {
+                svg::PathStyle line;
+                line.fill_color = svg::NoneColor;
+                line.stroke_color = color;
+                line.stroke_width = settings_.line_width;
+                line.stroke_line_cap = svg::StrokeLineCap::ROUND;
+                line.stroke_line_join = svg::StrokeLineJoin::ROUND;
+                styles.bus_lines.push_back(document.InternStyle(line));
+            }
+            break;
+        case Layer::BUS_LABELS: {
+            svg::Document::TextStyle label{settings_.bus_label_offset,
+                                           static_cast<uint32_t>(settings_.bus_label_font_size), 0,
+                                           document.InternString("Verdana"s), document.InternString("bold"s)};
+            styles.bus_label_underlayer = label;
+            styles.bus_label_underlayer.path_style = document.InternStyle(underlayer);
+            for (const std::string& color : settings_.color_palette) {
+                svg::PathStyle fill;
+                fill.fill_color = color;
+                label.path_style = document.InternStyle(fill);
+                styles.bus_labels.push_back(label);
+            }
+            break;
+        }
+        case Layer::STOP_CIRCLES: {
+            svg::PathStyle fill;
+            fill.fill_color = "white"s;
+            styles.stop_circle = document.InternStyle(fill);
+            break;
+        }
+        case Layer::STOP_NAMES: {
+            svg::PathStyle fill;
+            fill.fill_color = "black"s;
+            styles.stop_name = {settings_.stop_label_offset, static_cast<uint32_t>(settings_.stop_label_font_size),
+                                document.InternStyle(fill), document.InternString("Verdana"s),
+                                document.InternString(std::string())};
+            styles.stop_name_underlayer = styles.stop_name;
+            styles.stop_name_underlayer.path_style = document.InternStyle(underlayer);
+            break;
+        }
+        }
+        return styles;
+    }
 
-        svg::Text stop_name = basic_text;
-        stop_name.SetFillColor("black"s);
+    void MapRenderer::DrawLayerPart(svg::Document& document, const LayerPart& part, const RenderPlan& plan) const {
+        // Стили заносятся в документ один раз на часть слоя, объекты ссылаются на них по индексу
+        const LayerStyles styles = InternLayerStyles(document, part.layer);
+        std::vector<svg::Point> points;
+        for (size_t i = part.begin; i < part.end; ++i) {
+            switch (part.layer) {
+            case Layer::BUS_LINES:
+                DrawBusLine(document, *plan.buses[i].bus, styles.bus_lines.at(plan.buses[i].color_index), points);
+                break;
+            case Layer::BUS_LABELS:
+                DrawBusLabels(document, plan.buses[i], styles);
+                break;
+            case Layer::STOP_CIRCLES:
+                DrawStopCircle(document, *plan.stops[i], styles.stop_circle);
+                break;
+            case Layer::STOP_NAMES:
+                DrawStopName(document, *plan.stops[i], styles);
+                break;
+            }
+        }
+    }
 
-        map_.Add(substrate);
-        map_.Add(stop_name);
+    void MapRenderer::DrawBusLabelAtStop(svg::Document& document, std::string_view text, svg::Point position,
+                                         const svg::Document::TextStyle& label_style,
+                                         const svg::Document::TextStyle& underlayer_style) const {
+        document.AddText(position, text, underlayer_style);
+        document.AddText(position, text, label_style);
     }
 
-    std::string MapRenderer::PickColor() {
-        std::string color = settings_.color_palette.at(current_color_);
-        current_color_ = (current_color_ + 1) < settings_.color_palette.size() ? current_color_ + 1 : 0;
-        return color;
+    void MapRenderer::DrawBusLabels(svg::Document& document, const RenderPlan::BusEntry& entry,
+                                    const LayerStyles& styles) const {
+        const svg::Document::TextStyle& label_style = styles.bus_labels.at(entry.color_index);
+        DrawBusLabelAtStop(document, entry.bus->number, GetStopPoint(*entry.first_label_stop), label_style,
+                           styles.bus_label_underlayer);
+        if (entry.last_label_stop != nullptr) {
+            DrawBusLabelAtStop(document, entry.bus->number, GetStopPoint(*entry.last_label_stop), label_style,
+                               styles.bus_label_underlayer);
+        }
     }
 
-    void MapRenderer::DrawBusLine(const transport::Bus& bus, const std::string& bus_color) {
-        const auto& stops = bus.stops;
+    void MapRenderer::DrawStopCircle(svg::Document& document, const transport::Stop& stop,
+                                     svg::Document::StyleId style) const {
+        document.AddCircle(GetStopPoint(stop), settings_.stop_radius, style);
+    }
 
-        svg::Polyline bus_line;
-        bus_line.SetFillColor(svg::NoneColor).SetStrokeColor(bus_color).SetStrokeWidth(settings_.line_width)
-                  .SetStrokeLineCap(svg::StrokeLineCap::ROUND).SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    void MapRenderer::DrawStopName(svg::Document& document, const transport::Stop& stop,
+                                   const LayerStyles& styles) const {
+        document.AddText(GetStopPoint(stop), stop.name, styles.stop_name_underlayer);
+        document.AddText(GetStopPoint(stop), stop.name, styles.stop_name);
+    }
 
+    void MapRenderer::DrawBusLine(svg::Document& document, const transport::Bus& bus, svg::Document::StyleId style,
+                                  std::vector<svg::Point>& points) const {
+        points.clear();
         for (const std::weak_ptr<transport::Stop>& stop : bus.stops) {
-            bus_line.AddPoint(projector_(stop.lock()->coordinates));
+            points.push_back(GetStopPoint(*stop.lock()));
+        }
+        if (settings_.lod_tolerance > 0) {
+            // Прямой путь упрощается один раз, обратный путь некольцевого маршрута повторяет его
+            points = SimplifyPolyline(points, settings_.lod_tolerance);
         }
         if (!bus.is_circular) {
-            std::for_each(stops.rbegin() + 1, stops.rend(), [&](const std::weak_ptr<transport::Stop>& stop) {
-                bus_line.AddPoint(projector_.operator()(stop.lock()->coordinates));
-            });
+            const size_t forward_size = points.size();
+            points.reserve(forward_size * 2);
+            for (size_t i = forward_size; i-- > 1;) {
+                points.push_back(points[i - 1]);
+            }
         }
-
-        map_.Add(bus_line);
+        document.AddPolyline(points, style);
     }
 }
@@ -1,9 +1,16 @@
 #pragma once
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 
 #include "domain.h"
+#include "spatial_index.h"
 #include "svg.h"
+#include "transport_catalogue.h"
 #include "geo.h"
 
 namespace renderer {
@@ -77,6 +84,20 @@ namespace renderer {
             };
         }
 
+        // Проецирует все точки одним проходом без ветвлений, который компилятор может векторизовать
+        std::vector<svg::Point> Project(const std::vector<geo::Coordinates>& coordinates) const {
+            std::vector<svg::Point> points(coordinates.size());
+            const double min_lon = min_lon_;
+            const double max_lat = max_lat_;
+            const double zoom_coeff = zoom_coeff_;
+            const double padding = padding_;
+            for (size_t i = 0; i < coordinates.size(); ++i) {
+                points[i].x = (coordinates[i].lng - min_lon) * zoom_coeff + padding;
+                points[i].y = (max_lat - coordinates[i].lat) * zoom_coeff + padding;
+            }
+            return points;
+        }
+
     private:
         double padding_;
         double min_lon_ = 0;
@@ -90,35 +111,134 @@ namespace renderer {
         svg::Point bus_label_offset, stop_label_offset;
         std::string underlayer_color;
         std::vector<std::string> color_palette;
+        // Допуск упрощения линий маршрутов в пикселях; 0 - линии выводятся без упрощения
+        double lod_tolerance = 0;
+        // Карта в ответах сжимается gzip и кодируется base64
+        bool compress_map = false;
     };
 
+    /*
+     * План отрисовки карты для одного состояния справочника: маршруты и остановки в порядке
+     * вывода, номер цвета каждого маршрута в палитре и остановки, у которых выводится номер
+     * маршрута. Не зависит от остальных настроек отрисовки, поэтому переиспользуется
+     * всеми отрисовками, пока справочник не изменится
+     */
+    struct RenderPlan {
+        struct BusEntry {
+            const transport::Bus* bus = nullptr;
+            size_t color_index = 0;
+            const transport::Stop* first_label_stop = nullptr;
+            // Вторая подпись нужна некольцевому маршруту с разными конечными, иначе nullptr
+            const transport::Stop* last_label_stop = nullptr;
+        };
+
+        std::vector<BusEntry> buses;
+        std::vector<const transport::Stop*> stops;
+        uint64_t catalogue_version = 0;
+        size_t palette_size = 0;
+    };
+
+    RenderPlan BuildRenderPlan(const transport::Catalogue& catalogue, size_t palette_size);
+
+    // Упрощает ломаную: сливает точки, попадающие в один пиксель, и применяет алгоритм
+    // Дугласа-Пекера с допуском tolerance. Концы ломаной сохраняются
+    std::vector<svg::Point> SimplifyPolyline(const std::vector<svg::Point>& points, double tolerance);
+
     class MapRenderer {
     public:
         MapRenderer(RenderSettings settings, const SphereProjector& projector);
 
         void Render(std::ostream& out_stream) const;
+        void Render(io::OutputBuffer& out) const;
 
-        void AddBusToMap(const transport::Bus& bus);
+        // Возвращает отрисованную карту в виде JSON-строки (в кавычках и с экранированием),
+        // готовой для вставки в ответ. Результат запоминается и переиспользуется
+        // до следующего изменения документа. Этот метод и GetRenderedTileJson потокобезопасны
+        std::shared_ptr<const std::string> GetRenderedMapJson() const;
 
-        void AddBusNumberAtStop(const std::string& text, geo::Coordinates coordinates, const std::string& color);
-        void AddBusNumberToMap(const transport::Bus& bus);
+        // Кодировка карты в ответах: пустая строка для SVG как есть или "gzip+base64"
+        std::string_view GetMapEncoding() const;
 
-        void SetCurrentColor(const size_t color_number);
+        // Возвращает в том же виде фрагмент карты: на уровне zoom карта делится на 2^zoom x 2^zoom
+        // плиток, (x, y) - номер плитки слева направо и сверху вниз. В плитку попадают только
+        // объекты, пересекающие её область. Плитки запоминаются до следующего изменения документа.
+        // Для несуществующей плитки возвращает nullptr
+        std::shared_ptr<const std::string> GetRenderedTileJson(int zoom, int x, int y) const;
 
-        void DrawStopCircle(const transport::Stop& stop);
-
-        void DrawStopName(const transport::Stop& stop);
+        // Рисует карту по плану: линии маршрутов, названия маршрутов, круги остановок и названия
+        // остановок. Слои и их части строятся параллельно в отдельных документах и объединяются
+        // в порядке плана
+        void DrawMap(const RenderPlan& plan);
 
     private:
         RenderSettings settings_;
         SphereProjector projector_;
 
+        // Спроецированные координаты остановок карты по их номеру в справочнике
+        std::vector<svg::Point> stop_points_;
+
         svg::Document map_;
+        // Защищает запомненные карту, индекс и плитки: запросы к карте могут идти из нескольких потоков
+        mutable std::mutex cache_mutex_;
+        mutable std::shared_ptr<const std::string> rendered_map_json_;
+        mutable std::unique_ptr<svg::SpatialIndex> spatial_index_;
+        mutable std::unordered_map<uint64_t, std::shared_ptr<const std::string>> rendered_tiles_;
+
+        enum class Layer {
+            BUS_LINES,
+            BUS_LABELS,
+            STOP_CIRCLES,
+            STOP_NAMES,
+        };
+
+        // Часть слоя: элементы с индексами [begin, end) из списка маршрутов или остановок
+        struct LayerPart {
+            Layer layer;
+            size_t begin;
+            size_t end;
+        };
+
+        // Оформление слоя, занесённое в таблицы документа, в который рисуется часть слоя.
+        // Заполняются только поля, нужные слою; стили маршрутов - по номеру цвета в палитре
+        struct LayerStyles {
+            std::vector<svg::Document::StyleId> bus_lines;
+            std::vector<svg::Document::TextStyle> bus_labels;
+            svg::Document::TextStyle bus_label_underlayer;
+            svg::Document::StyleId stop_circle = 0;
+            svg::Document::TextStyle stop_name;
+            svg::Document::TextStyle stop_name_underlayer;
+        };
+
+        void InvalidateRenderedMap();
+
+        // Выводит часть документа через render в JSON-строку с учётом настройки сжатия
+        std::shared_ptr<const std::string> RenderJsonString(
+            const std::function<void(io::OutputBuffer&)>& render) const;
+
+        void ProjectStops(const std::vector<const transport::Stop*>& stops);
+
+        svg::Point GetStopPoint(const transport::Stop& stop) const {
+            return stop_points_[stop.index];
+        }
+
+        LayerStyles InternLayerStyles(svg::Document& document, Layer layer) const;
+
+        void DrawLayerPart(svg::Document& document, const LayerPart& part, const RenderPlan& plan) const;
+
+        // points - буфер вершин, переиспользуемый для всех маршрутов части слоя
+        void DrawBusLine(svg::Document& document, const transport::Bus& bus, svg::Document::StyleId style,
+                         std::vector<svg::Point>& points) const;
+
+        void DrawBusLabels(svg::Document& document, const RenderPlan::BusEntry& entry,
+                           const LayerStyles& styles) const;
 
-        size_t current_color_ = 0;
+        void DrawBusLabelAtStop(svg::Document& document, std::string_view text, svg::Point position,
+                                const svg::Document::TextStyle& label_style,
+                                const svg::Document::TextStyle& underlayer_style) const;
 
-        std::string PickColor();
+        void DrawStopCircle(svg::Document& document, const transport::Stop& stop,
+                            svg::Document::StyleId style) const;
 
-        void DrawBusLine(const transport::Bus& bus, const std::string& bus_color);
+        void DrawStopName(svg::Document& document, const transport::Stop& stop, const LayerStyles& styles) const;
     };
 }
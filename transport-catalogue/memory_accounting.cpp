@@ -0,0 +1,269 @@
+#include "memory_accounting.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "json_writer.h"
+#include "output_buffer.h"
+
+namespace memory {
+    using namespace std::literals;
+
+    namespace {
+        // Счётчики инициализируются константами, поэтому готовы к первому выделению памяти,
+        // которое может случиться раньше инициализации остальных статических объектов
+        struct Counters {
+            std::atomic<int64_t> current_bytes = 0;
+            std::atomic<int64_t> peak_bytes = 0;
+            std::atomic<uint64_t> allocations = 0;
+        };
+
+        constinit std::array<Counters, SUBSYSTEM_COUNT> counters{};
+        // -1 - переменная окружения ещё не прочитана, 0 - учёт выключен, 1 - включён
+        constinit std::atomic<int> tracking_state = -1;
+        constinit thread_local Subsystem current_subsystem = Subsystem::OTHER;
+
+        // Перед выделенным блоком хранится его размер и подсистема; заголовок занимает
+        // alignof(max_align_t) байт, чтобы не нарушать выравнивание блока
+        struct alignas(std::max_align_t) BlockHeader {
+            size_t size;
+            Subsystem subsystem;
+        };
+
+        bool ReadTrackingState() {
+            int state = tracking_state.load(std::memory_order_relaxed);
+            if (state < 0) {
+                const char* destination = std::getenv("TC_MEMORY_REPORT");
+                state = destination != nullptr && *destination != '\0' ? 1 : 0;
+                tracking_state.store(state, std::memory_order_relaxed);
+            }
+            return state == 1;
+        }
+
+        void* Allocate(size_t size, bool throws) {
+            const bool tracking = ReadTrackingState();
+            const size_t total_size = tracking ? size + sizeof(BlockHeader) : std::max<size_t>(size, 1);
+            void* block;
+            while ((block = std::malloc(total_size)) == nullptr) {
+                const std::new_handler handler = std::get_new_handler();
+                if (handler == nullptr) {
+                    if (throws) {
+                        throw std::bad_alloc();
+                    }
+                    return nullptr;
+                }
+                handler();
+            }
+            if (!tracking) {
+                return block;
+            }
+
+            const Subsystem subsystem = current_subsystem;
+            new (block) BlockHeader{size, subsystem};
+            Counters& subsystem_counters = counters[static_cast<size_t>(subsystem)];
+            subsystem_counters.allocations.fetch_add(1, std::memory_order_relaxed);
+            const int64_t current = subsystem_counters.current_bytes.fetch_add(static_cast<int64_t>(size),
+                                                                               std::memory_order_relaxed)
+                                    + static_cast<int64_t>(size);
+            int64_t peak = subsystem_counters.peak_bytes.load(std::memory_order_relaxed);
+            while (current > peak
+                   && !subsystem_counters.peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+            }
+            return static_cast<BlockHeader*>(block) + 1;
+        }
+
+        void Deallocate(void* pointer) {
+            if (pointer == nullptr) {
+                return;
+            }
+            // Память выделяется только через Allocate, и учёт не меняется после первого выделения
+            if (tracking_state.load(std::memory_order_relaxed) != 1) {
+                std::free(pointer);
+                return;
+            }
+            BlockHeader* const header = static_cast<BlockHeader*>(pointer) - 1;
+            counters[static_cast<size_t>(header->subsystem)].current_bytes.fetch_sub(
+                static_cast<int64_t>(header->size), std::memory_order_relaxed);
+            std::free(header);
+        }
+
+        // Подсистемы в порядке имён, в котором их ключи выводит json::Dict
+        constexpr std::array<Subsystem, SUBSYSTEM_COUNT> SUBSYSTEMS_BY_NAME = {
+            Subsystem::CATALOGUE, Subsystem::HANDLER, Subsystem::JSON,
+            Subsystem::OTHER, Subsystem::RENDERER, Subsystem::ROUTER};
+
+        // Состояния в конце этапов. Отчёт выводится из деструктора, то есть при завершении программы
+        class MemoryReport {
+        public:
+            MemoryReport() {
+                if (const char* destination = std::getenv("TC_MEMORY_REPORT"); destination != nullptr) {
+                    destination_ = destination;
+                }
+            }
+
+            MemoryReport(const MemoryReport&) = delete;
+
+            MemoryReport& operator=(const MemoryReport&) = delete;
+
+            ~MemoryReport() {
+                if (destination_ == "-"s) {
+                    Write(std::cerr);
+                }
+                else if (!destination_.empty()) {
+                    std::ofstream output(destination_);
+                    Write(output);
+                }
+            }
+
+            void AddPhase(std::string_view phase, const Stats& stats) {
+                std::lock_guard lock(mutex_);
+                phases_.emplace_back(std::string(phase), stats);
+            }
+
+            void Write(std::ostream& output) {
+                std::lock_guard lock(mutex_);
+                io::OutputBuffer buffer(output);
+                json::Writer writer(buffer);
+                writer.StartDict().Key("exit"sv);
+                WriteStats(writer, GetStats());
+                writer.Key("phases"sv).StartArray();
+                for (const auto& [phase, stats] : phases_) {
+                    writer.StartDict().Key("name"sv).Value(phase).Key("subsystems"sv);
+                    WriteStats(writer, stats);
+                    writer.EndDict();
+                }
+                writer.EndArray().EndDict();
+                buffer.Put('\n');
+                buffer.Flush();
+            }
+
+        private:
+            std::string destination_;
+            std::mutex mutex_;
+            std::vector<std::pair<std::string, Stats>> phases_;
+        };
+
+        MemoryReport& GetReport() {
+            static MemoryReport report;
+            return report;
+        }
+    }
+
+    bool IsTrackingEnabled() {
+        return ReadTrackingState();
+    }
+
+    std::string_view GetSubsystemName(Subsystem subsystem) {
+        switch (subsystem) {
+        case Subsystem::OTHER:
+            return "other"sv;
+        case Subsystem::JSON:
+            return "json"sv;
+        case Subsystem::CATALOGUE:
+            return "catalogue"sv;
+        case Subsystem::ROUTER:
+            return "router"sv;
+        case Subsystem::RENDERER:
+            return "renderer"sv;
+        case Subsystem::HANDLER:
+            return "handler"sv;
+        }
+        return {};
+    }
+
+    Stats GetStats() {
+        Stats stats;
+        for (size_t i = 0; i < SUBSYSTEM_COUNT; ++i) {
+            stats[i].current_bytes = counters[i].current_bytes.load(std::memory_order_relaxed);
+            stats[i].peak_bytes = counters[i].peak_bytes.load(std::memory_order_relaxed);
+            stats[i].allocations = counters[i].allocations.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    void RecordPhase(std::string_view phase) {
+        if (IsTrackingEnabled()) {
+            GetReport().AddPhase(phase, GetStats());
+        }
+    }
+
+    void WriteMemoryReport(std::ostream& output) {
+        GetReport().Write(output);
+    }
+
+    void WriteStats(json::Writer& writer, const Stats& stats) {
+        writer.StartDict();
+        for (const Subsystem subsystem : SUBSYSTEMS_BY_NAME) {
+            const SubsystemStats& subsystem_stats = stats[static_cast<size_t>(subsystem)];
+            writer.Key(GetSubsystemName(subsystem)).StartDict()
+                  .Key("allocations"sv).Value(static_cast<int64_t>(subsystem_stats.allocations))
+                  .Key("current_bytes"sv).Value(subsystem_stats.current_bytes)
+                  .Key("peak_bytes"sv).Value(subsystem_stats.peak_bytes)
+                  .EndDict();
+        }
+        writer.EndDict();
+    }
+
+    Subsystem GetCurrentSubsystem() {
+        return current_subsystem;
+    }
+
+    ScopedSubsystem::ScopedSubsystem(Subsystem subsystem)
+        : previous_(std::exchange(current_subsystem, subsystem)) {}
+
+    ScopedSubsystem::~ScopedSubsystem() {
+        current_subsystem = previous_;
+    }
+}
+
+// Замена глобальных операторов выделения памяти. Варианты с выравниванием не заменяются:
+// стандартная библиотека выделяет и освобождает такие блоки сама, минуя эти операторы
+
+void* operator new(size_t size) {
+    return memory::Allocate(size, true);
+}
+
+void* operator new[](size_t size) {
+    return memory::Allocate(size, true);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return memory::Allocate(size, false);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return memory::Allocate(size, false);
+}
+
+void operator delete(void* pointer) noexcept {
+    memory::Deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    memory::Deallocate(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    memory::Deallocate(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    memory::Deallocate(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    memory::Deallocate(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    memory::Deallocate(pointer);
+}
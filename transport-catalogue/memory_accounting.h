@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+namespace json {
+    class Writer;
+}
+
+namespace memory {
+    // Подсистемы, по которым учитывается память. Выделение относится к подсистеме, заданной
+    // в выделяющем потоке через ScopedSubsystem, а освобождение - к той, что память выделила
+    enum class Subsystem : uint8_t {
+        OTHER,
+        JSON,
+        CATALOGUE,
+        ROUTER,
+        RENDERER,
+        HANDLER,
+    };
+    inline constexpr size_t SUBSYSTEM_COUNT = 6;
+
+    struct SubsystemStats {
+        int64_t current_bytes = 0;
+        int64_t peak_bytes = 0;
+        uint64_t allocations = 0;
+    };
+
+    using Stats = std::array<SubsystemStats, SUBSYSTEM_COUNT>;
+
+    // Учёт включается переменной окружения TC_MEMORY_REPORT: "-" - отчёт в stderr, иначе путь к файлу
+    // отчёта. Переменная читается при первом выделении памяти, поэтому учитывается вся память процесса.
+    // Без неё operator new сразу передаёт выделение malloc
+    bool IsTrackingEnabled();
+
+    std::string_view GetSubsystemName(Subsystem subsystem);
+
+    // Подсистема, к которой относятся выделения текущего потока. Задачи, переданные в другой
+    // поток, восстанавливают её через ScopedSubsystem, см. threading::ThreadPool::Submit
+    Subsystem GetCurrentSubsystem();
+
+    // Текущее состояние всех подсистем; без учёта - нули
+    Stats GetStats();
+
+    // Запоминает состояние подсистем в конце этапа phase. При завершении программы запомненные
+    // состояния и итоговое выводятся JSON-отчётом
+    void RecordPhase(std::string_view phase);
+
+    void WriteMemoryReport(std::ostream& output);
+
+    // Выводит словарь: имя подсистемы -> allocations, current_bytes, peak_bytes
+    void WriteStats(json::Writer& writer, const Stats& stats);
+
+    // Относит выделения текущего потока к подсистеме до разрушения объекта
+    class ScopedSubsystem {
+    public:
+        explicit ScopedSubsystem(Subsystem subsystem);
+
+        ScopedSubsystem(const ScopedSubsystem&) = delete;
+
+        ScopedSubsystem& operator=(const ScopedSubsystem&) = delete;
+
+        ~ScopedSubsystem();
+
+    private:
+        Subsystem previous_;
+    };
+}
@@ -0,0 +1,184 @@
+#include "output_buffer.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace io {
+    namespace {
+        constexpr int DOUBLE_PRECISION = 6;
+
+        // Точные степени десяти от 10^0 до 10^9
+        constexpr double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+        /*
+         * Быстрый вывод числа в фиксированной записи формата %g (точность 6) без std::to_chars.
+         * Мантисса получается одним умножением на точную степень десяти; если результат
+         * слишком близок к середине между соседними значениями, округление неоднозначно
+         * и функция отказывается, оставляя число std::to_chars. Также отказывается для
+         * чисел, которые %g выводит в экспоненциальной записи.
+         */
+        char* TryWriteFixedDouble(char* out, double value) {
+            const double magnitude = std::abs(value);
+            if (!(magnitude >= 1e-4 && magnitude < 1e6)) {
+                return nullptr;
+            }
+
+            // Десятичный порядок числа: 10^exponent <= magnitude < 10^(exponent + 1)
+            int exponent = 5;
+            while (exponent >= 0 && magnitude < POWERS_OF_TEN[exponent]) {
+                --exponent;
+            }
+            while (exponent < 0 && magnitude * POWERS_OF_TEN[-exponent] < 1.0) {
+                --exponent;
+            }
+            if (exponent < -4) {
+                return nullptr;
+            }
+
+            const int scale = DOUBLE_PRECISION - 1 - exponent;
+            const double scaled = magnitude * POWERS_OF_TEN[scale];
+            const double floor_scaled = std::floor(scaled);
+            const double fraction = scaled - floor_scaled;
+            if (std::abs(fraction - 0.5) < 1e-6) {
+                return nullptr;
+            }
+            auto mantissa = static_cast<long long>(floor_scaled) + (fraction > 0.5 ? 1 : 0);
+            if (mantissa == 1'000'000) {
+                // Округление перенесло разряд, например 99999.97 -> 100000
+                mantissa = 100'000;
+                ++exponent;
+            }
+            if (mantissa < 100'000 || exponent > DOUBLE_PRECISION - 1) {
+                return nullptr;
+            }
+
+            char digits[DOUBLE_PRECISION];
+            for (int i = DOUBLE_PRECISION - 1; i >= 0; --i) {
+                digits[i] = static_cast<char>('0' + mantissa % 10);
+                mantissa /= 10;
+            }
+            int significant = DOUBLE_PRECISION;
+            while (significant > 1 && digits[significant - 1] == '0') {
+                --significant;
+            }
+
+            if (value < 0) {
+                *out++ = '-';
+            }
+            if (exponent >= 0) {
+                const int integer_digits = exponent + 1;
+                for (int i = 0; i < integer_digits; ++i) {
+                    *out++ = digits[i];
+                }
+                if (significant > integer_digits) {
+                    *out++ = '.';
+                    for (int i = integer_digits; i < significant; ++i) {
+                        *out++ = digits[i];
+                    }
+                }
+            }
+            else {
+                *out++ = '0';
+                *out++ = '.';
+                for (int i = 0; i < -exponent - 1; ++i) {
+                    *out++ = '0';
+                }
+                for (int i = 0; i < significant; ++i) {
+                    *out++ = digits[i];
+                }
+            }
+            return out;
+        }
+    }
+
+    OutputBuffer::OutputBuffer() = default;
+
+    OutputBuffer::OutputBuffer(std::ostream& sink, size_t capacity)
+        : sink_(&sink), capacity_(capacity) {
+        buffer_.reserve(capacity_ + capacity_ / 4);
+    }
+
+    OutputBuffer::~OutputBuffer() {
+        if (sink_ != nullptr) {
+            WriteToSink();
+        }
+    }
+
+    void OutputBuffer::WriteJsonEscaped(std::string_view data) {
+        using namespace std::literals;
+        size_t run_begin = 0;
+        for (size_t i = 0; i < data.size(); ++i) {
+            std::string_view escaped;
+            switch (data[i]) {
+            case '\r':
+                escaped = "\\r"sv;
+                break;
+            case '\n':
+                escaped = "\\n"sv;
+                break;
+            case '\t':
+                escaped = "\\t"sv;
+                break;
+            case '"':
+                // Символы " и \ выводятся как \" или \\, соответственно
+                escaped = "\\\""sv;
+                break;
+            case '\\':
+                escaped = "\\\\"sv;
+                break;
+            default:
+                continue;
+            }
+            // Участок без спецсимволов копируется целиком
+            buffer_.append(data.substr(run_begin, i - run_begin));
+            buffer_.append(escaped);
+            run_begin = i + 1;
+        }
+        buffer_.append(data.substr(run_begin));
+        FlushIfFull();
+    }
+
+    void OutputBuffer::WriteDouble(double value) {
+        // Формат general с точностью 6 совпадает с выводом std::ostream по умолчанию (%g)
+        char chars[32];
+        char* end = TryWriteFixedDouble(chars, value);
+        if (end == nullptr) {
+            end = std::to_chars(std::begin(chars), std::end(chars), value,
+                                std::chars_format::general, DOUBLE_PRECISION).ptr;
+        }
+        buffer_.append(chars, end);
+        FlushIfFull();
+    }
+
+    void OutputBuffer::WriteInt(long long value) {
+        char chars[24];
+        const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+        buffer_.append(chars, result.ptr);
+        FlushIfFull();
+    }
+
+    void OutputBuffer::WriteUnsigned(unsigned long long value) {
+        char chars[24];
+        const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+        buffer_.append(chars, result.ptr);
+        FlushIfFull();
+    }
+
+    void OutputBuffer::Flush() {
+        if (sink_ != nullptr) {
+            WriteToSink();
+            sink_->flush();
+        }
+    }
+
+    std::string OutputBuffer::Take() {
+        std::string result = std::move(buffer_);
+        buffer_.clear();
+        return result;
+    }
+
+    void OutputBuffer::WriteToSink() {
+        sink_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+}
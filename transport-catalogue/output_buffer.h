@@ -0,0 +1,133 @@
+#pragma once
+
+#include <concepts>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace io {
+    /*
+     * Буфер вывода, общий для json::Print и svg::Document.
+     * Накапливает байты в строке и отдаёт их в поток крупными блоками.
+     * Числа форматируются через std::to_chars так же, как их выводит
+     * std::ostream с настройками по умолчанию.
+     * Если поток не задан, буфер просто растёт и его содержимое можно забрать целиком.
+     * В режиме экранирования JSON весь текстовый вывод экранируется как содержимое
+     * JSON-строки: так документ можно сразу вывести в виде, готовом для вставки в JSON.
+     */
+    class OutputBuffer {
+    public:
+        static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+
+        OutputBuffer();
+
+        explicit OutputBuffer(std::ostream& sink, size_t capacity = DEFAULT_CAPACITY);
+
+        OutputBuffer(const OutputBuffer&) = delete;
+
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+        ~OutputBuffer();
+
+        void Put(char c) {
+            if (json_escaping_) {
+                WriteJsonEscaped({&c, 1});
+                return;
+            }
+            buffer_.push_back(c);
+            FlushIfFull();
+        }
+
+        void Write(std::string_view data) {
+            if (json_escaping_) {
+                WriteJsonEscaped(data);
+                return;
+            }
+            buffer_.append(data);
+            FlushIfFull();
+        }
+
+        // Пробелы и отступы не требуют экранирования
+        void WriteRepeated(char c, size_t count) {
+            buffer_.append(count, c);
+            FlushIfFull();
+        }
+
+        // Выводит уже подготовленные байты как есть, без экранирования
+        void WriteRaw(std::string_view data) {
+            buffer_.append(data);
+            FlushIfFull();
+        }
+
+        // Выводит data, экранируя спецсимволы JSON-строки (без обрамляющих кавычек)
+        void WriteJsonEscaped(std::string_view data);
+
+        // Включает или выключает экранирование JSON для всего последующего текстового вывода
+        void SetJsonEscaping(bool enabled) {
+            json_escaping_ = enabled;
+        }
+
+        bool IsJsonEscaping() const {
+            return json_escaping_;
+        }
+
+        // Выводит число так же, как operator<< потока с точностью 6 и форматом по умолчанию
+        void WriteDouble(double value);
+
+        void WriteInt(long long value);
+
+        void WriteUnsigned(unsigned long long value);
+
+        OutputBuffer& operator<<(std::string_view data) {
+            Write(data);
+            return *this;
+        }
+
+        OutputBuffer& operator<<(char c) {
+            Put(c);
+            return *this;
+        }
+
+        OutputBuffer& operator<<(double value) {
+            WriteDouble(value);
+            return *this;
+        }
+
+        template <std::signed_integral Int>
+        OutputBuffer& operator<<(Int value) {
+            WriteInt(value);
+            return *this;
+        }
+
+        template <std::unsigned_integral Int>
+        OutputBuffer& operator<<(Int value) {
+            WriteUnsigned(value);
+            return *this;
+        }
+
+        // Передаёт накопленные байты в поток и сбрасывает сам поток
+        void Flush();
+
+        // Содержимое буфера, ещё не переданное в поток
+        std::string_view View() const {
+            return buffer_;
+        }
+
+        // Забирает накопленное содержимое буфера без копирования
+        std::string Take();
+
+    private:
+        std::string buffer_;
+        std::ostream* sink_ = nullptr;
+        size_t capacity_ = DEFAULT_CAPACITY;
+        bool json_escaping_ = false;
+
+        void FlushIfFull() {
+            if (sink_ != nullptr && buffer_.size() >= capacity_) {
+                WriteToSink();
+            }
+        }
+
+        void WriteToSink();
+    };
+}
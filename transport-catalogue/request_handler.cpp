@@ -1,76 +1,246 @@
 #include "request_handler.h"
 
+#include "trace.h"
+
 namespace requesthandler {
-    RequestHandler::RequestHandler(transport::Catalogue& catalogue): catalogue_(catalogue) {
-        builder_.StartArray();
+    RequestHandler::RequestHandler(transport::Catalogue& catalogue, std::ostream& output, OutputMode mode)
+        : catalogue_(catalogue), owned_output_(std::make_unique<io::OutputBuffer>(output)), output_(*owned_output_),
+          writer_(output_, mode == OutputMode::LINES ? json::Writer::Layout::COMPACT : json::Writer::Layout::PRETTY),
+          mode_(mode), response_cache_(std::make_shared<ResponseCache>()) {}
+
+    // В режиме DOCUMENT ответы - элементы массива, поэтому выводятся с отступом первого уровня
+    RequestHandler::RequestHandler(const RequestHandler& parent, io::OutputBuffer& fragment_output)
+        : catalogue_(parent.catalogue_), output_(fragment_output),
+          writer_(output_,
+                  parent.mode_ == OutputMode::LINES ? json::Writer::Layout::COMPACT : json::Writer::Layout::PRETTY,
+                  parent.mode_ == OutputMode::LINES ? 0 : 1),
+          mode_(parent.mode_), is_fragment_(true), response_cache_(parent.response_cache_) {}
+
+    RequestHandler::RequestHandler(const RequestHandler& parent, std::ostream& output, OutputMode mode)
+        : catalogue_(parent.catalogue_), owned_output_(std::make_unique<io::OutputBuffer>(output)),
+          output_(*owned_output_),
+          writer_(output_, mode == OutputMode::LINES ? json::Writer::Layout::COMPACT : json::Writer::Layout::PRETTY),
+          mode_(mode), response_cache_(parent.response_cache_) {}
+
+    void RequestHandler::Flush() {
+        writer_.Flush();
     }
 
-    json::Document RequestHandler::GetDocument() {
-        return json::Document{builder_.EndArray().Build()};
+    void RequestHandler::Finish() {
+        tracing::Span span("RequestHandler::Finish"sv);
+        if (mode_ == OutputMode::DOCUMENT) {
+            StartResponse();
+            writer_.EndArray();
+        }
+        writer_.Flush();
     }
 
-    void RequestHandler::PrepareStop(int request_id, std::string_view stop_name) {
-        builder_.StartDict().Key("request_id"s).Value(request_id);
+    void RequestHandler::StartResponse() {
+        // Массив ответов открывается при первом выводе, чтобы ошибка при чтении
+        // базы не оставляла в выводе незакрытый массив
+        if (mode_ == OutputMode::DOCUMENT && !is_fragment_ && !started_) {
+            writer_.StartArray();
+            started_ = true;
+        }
+    }
+
+    void RequestHandler::EndResponse() {
+        if (mode_ == OutputMode::LINES && !is_fragment_) {
+            output_.Put('\n');
+        }
+    }
 
+    // Ключи ответов выводятся в лексикографическом порядке, как их упорядочивает json::Dict
+
+    void RequestHandler::PrepareStop(int request_id, std::string_view stop_name) {
         if (!catalogue_.HasStop(stop_name)) {
-            builder_.Key("error_message"s).Value("not found"s).EndDict();
+            PrepareError(request_id, "not found"s);
             return;
         }
 
-        builder_.Key("buses"s).StartArray();
+        StartResponse();
+        writer_.StartDict().Key("buses"sv).StartArray();
         const transport::Stop& stop = catalogue_.GetStop(stop_name);
         for (const transport::Bus* const passing_bus : stop.passing_busses) {
-            builder_.Value(passing_bus->number);
+            writer_.Value(passing_bus->number);
         }
-        builder_.EndArray().EndDict();
+        writer_.EndArray();
+        WriteRequestId(request_id);
+        writer_.EndDict();
+        EndResponse();
     }
 
     void RequestHandler::PrepareBus(int request_id, std::string_view bus_number) {
-        builder_.StartDict().Key("request_id").Value(request_id);
-
         if (!catalogue_.HasBus(bus_number)) {
-            builder_.Key("error_message"s).Value("not found"s).EndDict();
+            PrepareError(request_id, "not found"s);
             return;
         }
 
         BusInfo bus_info = GetBusInfo(bus_number);
-        builder_.Key("route_length"s).Value(bus_info.route_length)
-                .Key("curvature"s).Value(bus_info.curvature)
-                .Key("stop_count"s).Value(bus_info.stop_count)
-                .Key("unique_stop_count"s).Value(bus_info.unique_stop_count)
-                .EndDict();
+        StartResponse();
+        writer_.StartDict().Key("curvature"sv).Value(bus_info.curvature);
+        WriteRequestId(request_id);
+        writer_.Key("route_length"sv).Value(bus_info.route_length)
+               .Key("stop_count"sv).Value(bus_info.stop_count)
+               .Key("unique_stop_count"sv).Value(bus_info.unique_stop_count)
+               .EndDict();
+        EndResponse();
     }
 
-    void RequestHandler::PrepareMap(int request_id, const std::string& str) {
-        builder_.StartDict().Key("request_id").Value(request_id)
-                .Key("map"s).Value(str).EndDict();
+    void RequestHandler::PrepareMap(int request_id, std::string_view map_json, std::string_view encoding) {
+        StartResponse();
+        writer_.StartDict().Key("map"sv).RawValue(map_json);
+        if (!encoding.empty()) {
+            writer_.Key("map_encoding"sv).Value(encoding);
+        }
+        WriteRequestId(request_id);
+        writer_.EndDict();
+        EndResponse();
     }
 
     void RequestHandler::PrepareRoute(int request_id, double total_time,
                                       const std::vector<transport::RouteItem>& items) {
-        builder_.StartDict().Key("request_id"s).Value(request_id)
-                .Key("total_time"s).Value(total_time)
-                .Key("items"s).StartArray();
-        for (transport::RouteItem item : items) {
-            builder_.StartDict()
-                    .Key("type"s).Value(item.type)
-                    .Key("time"s).Value(item.time);
+        StartResponse();
+        writer_.StartDict().Key("items"sv).StartArray();
+        for (const transport::RouteItem& item : items) {
+            writer_.StartDict();
             if (item.type == "Wait"s) {
-                builder_.Key("stop_name"s).Value(item.stop_name);
+                writer_.Key("stop_name"sv).Value(item.stop_name);
             }
             else if (item.type == "Bus"s) {
-                builder_.Key("span_count"s).Value(item.span_count);
-                builder_.Key("bus"s).Value(item.bus);
+                writer_.Key("bus"sv).Value(item.bus)
+                       .Key("span_count"sv).Value(item.span_count);
             }
-            builder_.EndDict();
+            writer_.Key("time"sv).Value(item.time)
+                   .Key("type"sv).Value(item.type)
+                   .EndDict();
+        }
+        writer_.EndArray();
+        WriteRequestId(request_id);
+        writer_.Key("total_time"sv).Value(total_time).EndDict();
+        EndResponse();
+    }
+
+    void RequestHandler::PrepareMemory(int request_id, bool tracking_enabled, const memory::Stats& stats) {
+        StartResponse();
+        writer_.StartDict().Key("enabled"sv).Value(tracking_enabled);
+        WriteRequestId(request_id);
+        writer_.Key("subsystems"sv);
+        memory::WriteStats(writer_, stats);
+        writer_.EndDict();
+        EndResponse();
+    }
+
+    void RequestHandler::PrepareStats(int request_id, const EngineStats& stats) {
+        const auto to_int = [](uint64_t value) {
+            return static_cast<int64_t>(value);
+        };
+
+        StartResponse();
+        writer_.StartDict().Key("catalogue"sv).StartDict()
+               .Key("buses"sv).Value(to_int(catalogue_.GetAllBusses().size()))
+               .Key("distances"sv).Value(to_int(catalogue_.GetDistanceCount()))
+               .Key("stops"sv).Value(to_int(catalogue_.GetAllStops().size()))
+               .EndDict();
+        WriteRequestId(request_id);
+
+        writer_.Key("requests"sv).StartDict();
+        for (const EngineStats::RequestTypeStats& type_stats : stats.requests) {
+            writer_.Key(type_stats.type).StartDict()
+                   .Key("count"sv).Value(to_int(type_stats.count))
+                   .Key("deadline_exceeded"sv).Value(to_int(type_stats.deadline_exceeded))
+                   .Key("total_time_ns"sv).Value(static_cast<int64_t>(type_stats.total_time.count()))
+                   .EndDict();
         }
-        builder_.EndArray();
-        builder_.EndDict();
+        writer_.EndDict();
+
+        const ResponseCache::Stats cache_stats = response_cache_->GetStats();
+        writer_.Key("response_cache"sv).StartDict()
+               .Key("bytes"sv).Value(to_int(cache_stats.bytes))
+               .Key("entries"sv).Value(to_int(cache_stats.entries))
+               .Key("hits"sv).Value(to_int(cache_stats.hits))
+               .Key("misses"sv).Value(to_int(cache_stats.misses))
+               .EndDict();
+
+        const transport::Router::Stats router_stats = stats.router.value_or(transport::Router::Stats{});
+        writer_.Key("router"sv).StartDict()
+               .Key("built"sv).Value(stats.router.has_value())
+               .Key("edges"sv).Value(to_int(router_stats.edge_count))
+               .Key("routes_table_bytes"sv).Value(to_int(router_stats.routes_table_bytes))
+               .Key("vertices"sv).Value(to_int(router_stats.vertex_count))
+               .EndDict()
+               .Key("search"sv).StartDict()
+               .Key("relaxations"sv).Value(to_int(router_stats.relaxation_count))
+               .Key("route_edges"sv).Value(to_int(router_stats.route_edges))
+               .Key("route_queries"sv).Value(to_int(router_stats.route_queries))
+               .EndDict()
+               .EndDict();
+        EndResponse();
     }
 
     void RequestHandler::PrepareError(int request_id, std::string error_message) {
-        builder_.StartDict().Key("request_id").Value(request_id)
-                .Key("error_message"s).Value(std::move(error_message)).EndDict();
+        StartResponse();
+        writer_.StartDict().Key("error_message"sv).Value(error_message);
+        WriteRequestId(request_id);
+        writer_.EndDict();
+        EndResponse();
+    }
+
+    void RequestHandler::PrepareError(std::string error_message) {
+        StartResponse();
+        writer_.StartDict()
+               .Key("error_message"sv).Value(error_message)
+               .EndDict();
+        EndResponse();
+    }
+
+    void RequestHandler::PrepareFragment(std::string_view response_json) {
+        StartResponse();
+        writer_.RawValue(response_json);
+        EndResponse();
+    }
+
+    void RequestHandler::PrepareMemoized(std::string_view key, int request_id,
+                                         const std::function<void(RequestHandler&)>& prepare) {
+        const uint64_t version = catalogue_.GetVersion();
+        if (const auto response = response_cache_->Find(key, version)) {
+            const std::string_view body(response->body);
+            StartResponse();
+            writer_.RawValue(body.substr(0, response->request_id_offset));
+            output_ << request_id << body.substr(response->request_id_offset);
+            EndResponse();
+            return;
+        }
+
+        // Ответ готовится отдельно, чтобы запомнить его вывод без request_id
+        io::OutputBuffer buffer;
+        RequestHandler recording_handler(*this, buffer);
+        recording_handler.records_request_id_ = true;
+        prepare(recording_handler);
+        PrepareFragment(buffer.View());
+
+        if (const auto range = recording_handler.request_id_range_) {
+            std::string body = buffer.Take();
+            body.erase(range->first, range->second - range->first);
+            response_cache_->Put(std::string(key), version, {std::move(body), range->first});
+        }
+    }
+
+    void RequestHandler::ClearResponseCache() {
+        response_cache_->Clear();
+    }
+
+    ResponseCache::Stats RequestHandler::GetResponseCacheStats() const {
+        return response_cache_->GetStats();
+    }
+
+    void RequestHandler::WriteRequestId(int request_id) {
+        writer_.Key("request_id"sv);
+        const size_t begin = output_.View().size();
+        writer_.Value(request_id);
+        if (records_request_id_) {
+            request_id_range_.emplace(begin, output_.View().size());
+        }
     }
 
     RequestHandler::BusInfo RequestHandler::GetBusInfo(std::string_view bus_number) const {
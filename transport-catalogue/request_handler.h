@@ -1,42 +1,128 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <sstream>
+#include <utility>
 
 #include "transport_catalogue.h"
 #include "geo.h"
 #include "json.h"
-#include "json_builder.h"
+#include "json_writer.h"
+#include "memory_accounting.h"
+#include "output_buffer.h"
+#include "response_cache.h"
 #include "transport_router.h"
 
 
 namespace requesthandler {
     using namespace std::literals;
 
+    // DOCUMENT - ответы выводятся одним JSON-массивом, как в json::Print;
+    // LINES - каждый ответ выводится компактно в отдельной строке (NDJSON)
+    enum class OutputMode {
+        DOCUMENT,
+        LINES,
+    };
+
+    // Счётчики для ответа на запрос Stats, которые ведёт не сам обработчик
+    struct EngineStats {
+        struct RequestTypeStats {
+            std::string_view type;
+            uint64_t count = 0;
+            uint64_t deadline_exceeded = 0;
+            std::chrono::nanoseconds total_time{};
+        };
+
+        // Упорядочены по type
+        std::vector<RequestTypeStats> requests;
+        // Пусто, если маршрутизатор ещё не построен
+        std::optional<transport::Router::Stats> router;
+    };
+
     class RequestHandler {
     public:
-        explicit RequestHandler(transport::Catalogue& catalogue);
+        RequestHandler(transport::Catalogue& catalogue, std::ostream& output,
+                       OutputMode mode = OutputMode::DOCUMENT);
+
+        // Обработчик для отдельного вывода ответов: пишет их в fragment_output в том же формате,
+        // в каком их вывел бы parent, но без массива и разделителей между ответами.
+        // Вывод одного ответа затем передаётся в parent.PrepareFragment
+        RequestHandler(const RequestHandler& parent, io::OutputBuffer& fragment_output);
+
+        // Обработчик со своим выводом и режимом, который делит с parent запомненные ответы.
+        // Так все подключения сервера пользуются одним кэшем ответов процесса
+        RequestHandler(const RequestHandler& parent, std::ostream& output, OutputMode mode);
 
-        json::Document GetDocument();
+        // Сбрасывает накопленные ответы в поток вывода
+        void Flush();
+
+        // Завершает массив ответов и сбрасывает вывод
+        void Finish();
 
         void PrepareStop(int request_id, std::string_view stop_name);
 
         void PrepareBus(int request_id, std::string_view bus_number);
 
-        void PrepareMap(int request_id, const std::string& str);
+        // map_json - карта, уже представленная JSON-строкой, см. MapRenderer::GetRenderedMapJson.
+        // Непустая encoding выводится в поле map_encoding
+        void PrepareMap(int request_id, std::string_view map_json, std::string_view encoding = {});
 
         void PrepareRoute(int request_id, double total_time, const std::vector<transport::RouteItem>& items);
 
+        // Память подсистем, см. memory::GetStats; без учёта памяти все счётчики нулевые
+        void PrepareMemory(int request_id, bool tracking_enabled, const memory::Stats& stats);
+
+        // Размеры справочника и счётчики кэша ответов вместе с переданными счётчиками
+        void PrepareStats(int request_id, const EngineStats& stats);
+
         void PrepareError(int request_id, std::string error_message);
 
+        // Ответ на запрос, у которого не удалось определить request_id
+        void PrepareError(std::string error_message);
+
+        // Выводит ответ, подготовленный обработчиком для отдельного вывода
+        void PrepareFragment(std::string_view response_json);
+
+        // Выводит запомненный под key ответ с новым request_id. Если ответа нет, готовит его
+        // через prepare и запоминает. key строится ResponseCache::MakeKey и должен однозначно
+        // определять ответ при текущем состоянии справочника
+        void PrepareMemoized(std::string_view key, int request_id,
+                             const std::function<void(RequestHandler&)>& prepare);
+
+        // Забывает запомненные ответы; нужно, если ответы изменились без изменения справочника
+        void ClearResponseCache();
+
+        ResponseCache::Stats GetResponseCacheStats() const;
+
     private:
         transport::Catalogue& catalogue_;
-        json::Builder builder_;
+        std::unique_ptr<io::OutputBuffer> owned_output_;
+        io::OutputBuffer& output_;
+        json::Writer writer_;
+        OutputMode mode_;
+        bool is_fragment_ = false;
+        bool started_ = false;
+        std::shared_ptr<ResponseCache> response_cache_;
+
+        // Границы значения request_id в выводе ответа, который готовится для кэша
+        bool records_request_id_ = false;
+        std::optional<std::pair<size_t, size_t>> request_id_range_;
 
         struct BusInfo {
             int stop_count, unique_stop_count;
             double route_length, curvature;
         };
 
+        void StartResponse();
+
+        void EndResponse();
+
+        void WriteRequestId(int request_id);
+
         BusInfo GetBusInfo(std::string_view bus_number) const;
 
         static size_t CountStops(const transport::Bus& bus);
@@ -0,0 +1,242 @@
+#include "request_scheduler.h"
+
+#include <algorithm>
+#include <future>
+
+#include "memory_accounting.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace jsonreader {
+    using namespace std::literals;
+
+    namespace {
+        // Пул для дорогих запросов: они не занимают потоки общего пула, на котором идут дешёвые
+        threading::ThreadPool& GetExpensiveRequestPool() {
+            static threading::ThreadPool pool(std::max<size_t>(1, threading::GetHardwareConcurrency() / 2));
+            return pool;
+        }
+
+        size_t ToIndex(StatRequest::Type type) {
+            return static_cast<size_t>(type);
+        }
+    }
+
+    std::string_view StatRequest::GetTypeName(Type type) {
+        switch (type) {
+        case Type::STOP:
+            return "Stop"sv;
+        case Type::BUS:
+            return "Bus"sv;
+        case Type::ROUTE:
+            return "Route"sv;
+        case Type::MAP:
+            return "Map"sv;
+        case Type::MAP_TILE:
+            return "MapTile"sv;
+        case Type::MEMORY:
+            return "Memory"sv;
+        case Type::STATS:
+            return "Stats"sv;
+        case Type::UNKNOWN:
+            break;
+        }
+        return {};
+    }
+
+    CostModel::CostModel() {
+        // Начальные оценки в наносекундах, порядок совпадает с StatRequest::Type
+        constexpr std::array<double, StatRequest::TYPE_COUNT> initial_estimates = {
+            0., 2'000., 5'000., 50'000., 10'000'000., 1'000'000., 5'000., 20'000.};
+        for (size_t i = 0; i < StatRequest::TYPE_COUNT; ++i) {
+            estimates_[i].store(initial_estimates[i], std::memory_order_relaxed);
+        }
+    }
+
+    CostModel::Duration CostModel::Estimate(StatRequest::Type type) const {
+        const double estimate = estimates_[ToIndex(type)].load(std::memory_order_relaxed);
+        return std::chrono::duration_cast<Duration>(std::chrono::duration<double, std::nano>(estimate));
+    }
+
+    void CostModel::Record(StatRequest::Type type, Duration cost) {
+        // Одновременные замеры могут затереть друг друга; для оценки это допустимо
+        std::atomic<double>& estimate = estimates_[ToIndex(type)];
+        const double previous = estimate.load(std::memory_order_relaxed);
+        const double sample = std::min(std::chrono::duration<double, std::nano>(cost).count(),
+                                       std::max(previous, 1.) * MAX_SAMPLE_GROWTH);
+        estimate.store(previous + SMOOTHING * (sample - previous), std::memory_order_relaxed);
+    }
+
+    RequestScheduler::RequestScheduler(Executor executor, ColdCheck is_cold)
+        : executor_(std::move(executor)), is_cold_(std::move(is_cold)) {
+        for (size_t i = 1; i < StatRequest::TYPE_COUNT; ++i) {
+            latencies_[i] = metrics::GetLatencyHistogram(
+                "requests"sv, StatRequest::GetTypeName(static_cast<StatRequest::Type>(i)));
+        }
+    }
+
+    bool RequestScheduler::IsExpensive(StatRequest::Type type) const {
+        return cost_model_.Estimate(type) >= EXPENSIVE_REQUEST_COST || (is_cold_ && is_cold_(type));
+    }
+
+    bool RequestScheduler::IsExpensiveRequestThread() {
+        return GetExpensiveRequestPool().IsCurrentThreadWorker();
+    }
+
+    void RequestScheduler::Run(const std::vector<StatRequest>& requests, requesthandler::RequestHandler& handler,
+                               Clock::time_point arrival) {
+        tracing::Span span("RequestScheduler::Run"sv);
+        if (requests.size() < PARALLEL_BATCH_SIZE || threading::GetHardwareConcurrency() <= 1) {
+            for (const StatRequest& request : requests) {
+                Execute(request, handler, arrival);
+            }
+            return;
+        }
+        for (size_t window_begin = 0; window_begin < requests.size(); window_begin += REQUESTS_PER_WINDOW) {
+            const size_t window_end = std::min(window_begin + REQUESTS_PER_WINDOW, requests.size());
+            RunWindow(requests.data() + window_begin, requests.data() + window_end, handler, arrival);
+        }
+    }
+
+    bool RequestScheduler::Execute(const StatRequest& request, requesthandler::RequestHandler& handler,
+                                   Clock::time_point arrival) {
+        if (request.type == StatRequest::Type::UNKNOWN) {
+            return false;
+        }
+        const Clock::time_point start = Clock::now();
+        if (request.deadline_ms > 0
+            && start + cost_model_.Estimate(request.type) > arrival + std::chrono::milliseconds(request.deadline_ms)) {
+            handler.PrepareError(request.id, "deadline exceeded"s);
+            deadline_exceeded_counts_[ToIndex(request.type)].Add(1);
+            return true;
+        }
+        const bool is_known = executor_(request, handler);
+        const Clock::duration cost = Clock::now() - start;
+        cost_model_.Record(request.type, cost);
+        request_counts_[ToIndex(request.type)].Add(1);
+        request_times_[ToIndex(request.type)].Add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(cost).count());
+        if (metrics::LatencyHistogram* const latency = latencies_[ToIndex(request.type)]) {
+            latency->Record(cost);
+        }
+        return is_known;
+    }
+
+    RequestScheduler::TypeStats RequestScheduler::GetTypeStats(StatRequest::Type type) const {
+        const size_t index = ToIndex(type);
+        return {request_counts_[index].Get(), deadline_exceeded_counts_[index].Get(),
+                std::chrono::nanoseconds(request_times_[index].Get())};
+    }
+
+    void RequestScheduler::ExecuteRequests(const StatRequest* begin, const StatRequest* end,
+                                           const requesthandler::RequestHandler& parent, ResponseBatch& batch,
+                                           Clock::time_point arrival) {
+        tracing::Span span("RequestScheduler::ExecuteRequests"sv);
+        memory::ScopedSubsystem subsystem(memory::Subsystem::HANDLER);
+        batch.response_ends.reserve(end - begin);
+        io::OutputBuffer buffer;
+        requesthandler::RequestHandler fragment_handler(parent, buffer);
+        try {
+            for (const StatRequest* request = begin; request != end; ++request) {
+                Execute(*request, fragment_handler, arrival);
+                batch.response_ends.push_back(buffer.View().size());
+            }
+        }
+        catch (...) {
+            batch.error = std::current_exception();
+        }
+        batch.responses = buffer.Take();
+    }
+
+    void RequestScheduler::WriteResponses(const ResponseBatch& batch, requesthandler::RequestHandler& handler) {
+        const std::string_view responses(batch.responses);
+        size_t response_begin = 0;
+        for (const size_t response_end : batch.response_ends) {
+            // Запрос неизвестного типа ответа не даёт
+            if (response_end != response_begin) {
+                handler.PrepareFragment(responses.substr(response_begin, response_end - response_begin));
+            }
+            response_begin = response_end;
+        }
+        if (batch.error) {
+            std::rethrow_exception(batch.error);
+        }
+    }
+
+    void RequestScheduler::RunWindow(const StatRequest* begin, const StatRequest* end,
+                                     requesthandler::RequestHandler& handler, Clock::time_point arrival) {
+        // Задача - запросы [begin, end) окна; дорогой запрос всегда образует отдельную задачу
+        struct Task {
+            const StatRequest* begin;
+            const StatRequest* end;
+            bool is_expensive;
+        };
+
+        // Вид запросов определяется один раз на окно: проверка подготовки данных может брать блокировку
+        std::array<bool, StatRequest::TYPE_COUNT> is_expensive_type{};
+        for (size_t i = 0; i < StatRequest::TYPE_COUNT; ++i) {
+            is_expensive_type[i] = IsExpensive(static_cast<StatRequest::Type>(i));
+        }
+
+        std::vector<Task> tasks;
+        std::vector<size_t> cheap_tasks;
+        const StatRequest* task_begin = begin;
+        CostModel::Duration task_cost{};
+        const auto close_cheap_task = [&](const StatRequest* task_end) {
+            if (task_end != task_begin) {
+                cheap_tasks.push_back(tasks.size());
+                tasks.push_back({task_begin, task_end, false});
+            }
+            task_begin = task_end;
+            task_cost = {};
+        };
+        for (const StatRequest* request = begin; request != end; ++request) {
+            if (is_expensive_type[ToIndex(request->type)]) {
+                close_cheap_task(request);
+                tasks.push_back({request, request + 1, true});
+                task_begin = request + 1;
+                continue;
+            }
+            task_cost += cost_model_.Estimate(request->type);
+            if (task_cost >= CHEAP_TASK_COST || static_cast<size_t>(request + 1 - task_begin) >= MAX_REQUESTS_PER_TASK) {
+                close_cheap_task(request + 1);
+            }
+        }
+        close_cheap_task(end);
+
+        std::vector<ResponseBatch> results(tasks.size());
+        std::vector<std::future<void>> expensive_results(tasks.size());
+        threading::ThreadPool& expensive_pool = GetExpensiveRequestPool();
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            if (tasks[i].is_expensive) {
+                expensive_results[i] = expensive_pool.Submit([this, &tasks, &results, &handler, arrival, i] {
+                    ExecuteRequests(tasks[i].begin, tasks[i].end, handler, results[i], arrival);
+                });
+            }
+        }
+        threading::ParallelFor(cheap_tasks.size(), [&](size_t i) {
+            const Task& task = tasks[cheap_tasks[i]];
+            ExecuteRequests(task.begin, task.end, handler, results[cheap_tasks[i]], arrival);
+        });
+
+        // Дорогие задачи ссылаются на results, поэтому ошибку вывода пробрасываем, только дождавшись их
+        tracing::Span span("RequestScheduler::WriteResponses"sv);
+        std::exception_ptr error;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            if (tasks[i].is_expensive) {
+                expensive_results[i].wait();
+            }
+            if (!error) {
+                try {
+                    WriteResponses(results[i], handler);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
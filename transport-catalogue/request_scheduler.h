@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "latency_histogram.h"
+#include "request_handler.h"
+#include "sharded_counter.h"
+
+namespace jsonreader {
+    // Запрос к справочнику, разобранный из JSON. Строки указывают в исходный JSON-документ
+    // и действительны, пока он существует
+    struct StatRequest {
+        enum class Type : uint8_t {
+            UNKNOWN,
+            STOP,
+            BUS,
+            ROUTE,
+            MAP,
+            MAP_TILE,
+            MEMORY,
+            STATS,
+        };
+        static constexpr size_t TYPE_COUNT = 8;
+
+        // Значение поля type запроса этого типа; для UNKNOWN - пустая строка
+        static std::string_view GetTypeName(Type type);
+
+        Type type = Type::UNKNOWN;
+        int id = 0;
+        // Срок ответа в миллисекундах от поступления запроса; 0 - без срока
+        int deadline_ms = 0;
+        // Stop и Bus: название; Route: остановка отправления
+        std::string_view name;
+        // Route: остановка назначения
+        std::string_view to;
+        // MapTile: уровень и номер плитки
+        int zoom = 0;
+        int x = 0;
+        int y = 0;
+    };
+
+    /*
+     * Оценка времени ответа на запрос каждого типа. Начальные оценки уточняются замерами
+     * экспоненциальным сглаживанием. Один замер может увеличить оценку не больше чем
+     * в MAX_SAMPLE_GROWTH раз, поэтому разовая задержка вроде первого построения маршрутизатора
+     * не делает дешёвый тип дорогим. Методы потокобезопасны
+     */
+    class CostModel {
+    public:
+        using Duration = std::chrono::steady_clock::duration;
+
+        CostModel();
+
+        Duration Estimate(StatRequest::Type type) const;
+
+        void Record(StatRequest::Type type, Duration cost);
+
+    private:
+        static constexpr double SMOOTHING = 0.1;
+        static constexpr double MAX_SAMPLE_GROWTH = 4.;
+
+        // Оценки в наносекундах
+        std::array<std::atomic<double>, StatRequest::TYPE_COUNT> estimates_;
+    };
+
+    /*
+     * Отвечает на пакеты запросов через RequestHandler, выводя ответы в порядке запросов.
+     * Дешёвые запросы объединяются в задачи примерно равной оценённой стоимости и выполняются
+     * на общем пуле, а дорогие (обычно Map и Route) выполняются по одному на отдельном пуле,
+     * чтобы не задерживать задачи из дешёвых запросов. Дорогим считается и запрос, который
+     * запустит долгую подготовку данных, например первое построение маршрутизатора: оценка
+     * стоимости такой подготовки не учитывает. Запрос, который по оценке не успеет
+     * к своему сроку, получает ответ с ошибкой "deadline exceeded" вместо выполнения
+     */
+    class RequestScheduler {
+    public:
+        using Clock = std::chrono::steady_clock;
+        // Готовит ответ на запрос; возвращает false, если тип запроса неизвестен
+        using Executor = std::function<bool(const StatRequest&, requesthandler::RequestHandler&)>;
+        // Возвращает true, если запрос этого типа сейчас запустит долгую подготовку данных
+        using ColdCheck = std::function<bool(StatRequest::Type)>;
+
+        // Ответы на несколько запросов подряд: response_ends[i] - конец ответа на i-й запрос.
+        // Как и последовательная обработка, подготовка останавливается на первом исключении
+        struct ResponseBatch {
+            std::string responses;
+            std::vector<size_t> response_ends;
+            std::exception_ptr error;
+        };
+
+        explicit RequestScheduler(Executor executor, ColdCheck is_cold = {});
+
+        // Выполнит ли Run запрос этого типа отдельной задачей на пуле дорогих запросов
+        bool IsExpensive(StatRequest::Type type) const;
+
+        // Выполняется ли вызывающий код в потоке пула дорогих запросов
+        static bool IsExpensiveRequestThread();
+
+        // Отвечает на запросы пакета, поступившие в момент arrival
+        void Run(const std::vector<StatRequest>& requests, requesthandler::RequestHandler& handler,
+                 Clock::time_point arrival);
+
+        // Отвечает на один запрос с учётом его срока и уточняет оценку стоимости его типа
+        bool Execute(const StatRequest& request, requesthandler::RequestHandler& handler, Clock::time_point arrival);
+
+        // Готовит ответы на запросы [begin, end) в отдельном буфере в формате обработчика parent
+        void ExecuteRequests(const StatRequest* begin, const StatRequest* end,
+                             const requesthandler::RequestHandler& parent, ResponseBatch& batch,
+                             Clock::time_point arrival);
+
+        // Выводит готовые ответы и пробрасывает исключение, на котором остановилась их подготовка
+        static void WriteResponses(const ResponseBatch& batch, requesthandler::RequestHandler& handler);
+
+        const CostModel& GetCostModel() const {
+            return cost_model_;
+        }
+
+        // Запросы типа, на которые отвечал Execute, и суммарное время ответа на них
+        struct TypeStats {
+            uint64_t count = 0;
+            uint64_t deadline_exceeded = 0;
+            std::chrono::nanoseconds total_time{};
+        };
+
+        TypeStats GetTypeStats(StatRequest::Type type) const;
+
+    private:
+        // Пакеты от PARALLEL_BATCH_SIZE запросов выполняются параллельно окнами по REQUESTS_PER_WINDOW.
+        // Задача из дешёвых запросов набирается до оценки CHEAP_TASK_COST или MAX_REQUESTS_PER_TASK
+        // запросов; запрос с оценкой от EXPENSIVE_REQUEST_COST считается дорогим
+        static constexpr size_t PARALLEL_BATCH_SIZE = 256;
+        static constexpr size_t REQUESTS_PER_WINDOW = 8192;
+        static constexpr size_t MAX_REQUESTS_PER_TASK = 256;
+        static constexpr std::chrono::microseconds CHEAP_TASK_COST{200};
+        static constexpr std::chrono::microseconds EXPENSIVE_REQUEST_COST{200};
+
+        Executor executor_;
+        ColdCheck is_cold_;
+        CostModel cost_model_;
+        // Гистограммы времени ответа по типам запросов; пусты, если замеры выключены
+        std::array<metrics::LatencyHistogram*, StatRequest::TYPE_COUNT> latencies_{};
+        std::array<metrics::ShardedCounter, StatRequest::TYPE_COUNT> request_counts_;
+        std::array<metrics::ShardedCounter, StatRequest::TYPE_COUNT> deadline_exceeded_counts_;
+        // Наносекунды
+        std::array<metrics::ShardedCounter, StatRequest::TYPE_COUNT> request_times_;
+
+        void RunWindow(const StatRequest* begin, const StatRequest* end, requesthandler::RequestHandler& handler,
+                       Clock::time_point arrival);
+    };
+}
@@ -0,0 +1,57 @@
+#include "response_cache.h"
+
+namespace requesthandler {
+    std::string ResponseCache::MakeKey(char type, std::string_view first, std::string_view second) {
+        std::string key(1, type);
+        key += std::to_string(first.size());
+        key += ':';
+        key += first;
+        key += second;
+        return key;
+    }
+
+    std::shared_ptr<const ResponseCache::Response> ResponseCache::Find(std::string_view key, uint64_t version) {
+        {
+            std::lock_guard lock(mutex_);
+            if (version != version_) {
+                ClearLocked();
+                version_ = version;
+            }
+            else if (const auto it = responses_.find(key); it != responses_.end()) {
+                ++hits_;
+                return it->second;
+            }
+        }
+        ++misses_;
+        return nullptr;
+    }
+
+    void ResponseCache::Put(std::string key, uint64_t version, Response response) {
+        const size_t response_bytes = key.size() + response.body.size();
+        std::lock_guard lock(mutex_);
+        if (version != version_) {
+            return;
+        }
+        if (responses_.size() >= MAX_ENTRIES || bytes_ + response_bytes > MAX_BYTES) {
+            ClearLocked();
+        }
+        if (responses_.emplace(std::move(key), std::make_shared<const Response>(std::move(response))).second) {
+            bytes_ += response_bytes;
+        }
+    }
+
+    void ResponseCache::Clear() {
+        std::lock_guard lock(mutex_);
+        ClearLocked();
+    }
+
+    ResponseCache::Stats ResponseCache::GetStats() const {
+        std::lock_guard lock(mutex_);
+        return {hits_, misses_, responses_.size(), bytes_};
+    }
+
+    void ResponseCache::ClearLocked() {
+        responses_.clear();
+        bytes_ = 0;
+    }
+}
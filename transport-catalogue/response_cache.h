@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace requesthandler {
+    /*
+     * Кэш готовых ответов на запросы Stop, Bus и Route. Ответ хранится уже выведенным,
+     * но без значения request_id: оно подставляется при выводе. Ответы действительны
+     * для одной версии справочника; при обращении с другой версией кэш очищается.
+     * Переполненный кэш очищается целиком. Все методы потокобезопасны.
+     */
+    class ResponseCache {
+    public:
+        struct Response {
+            // Ответ без значения request_id и позиция, на которой оно стоит
+            std::string body;
+            size_t request_id_offset;
+        };
+
+        struct Stats {
+            uint64_t hits;
+            uint64_t misses;
+            size_t entries;
+            size_t bytes;
+        };
+
+        // Ключ запроса: тип запроса и его аргументы. Длина первого аргумента входит в ключ,
+        // поэтому разные пары (from, to) не совпадают
+        static std::string MakeKey(char type, std::string_view first, std::string_view second = {});
+
+        // Возвращает запомненный для version ответ или nullptr
+        std::shared_ptr<const Response> Find(std::string_view key, uint64_t version);
+
+        void Put(std::string key, uint64_t version, Response response);
+
+        // Забывает все ответы, например после перестроения маршрутизатора
+        void Clear();
+
+        Stats GetStats() const;
+
+    private:
+        static constexpr size_t MAX_ENTRIES = 65536;
+        static constexpr size_t MAX_BYTES = 64 << 20;
+
+        struct KeyHasher {
+            using is_transparent = void;
+
+            size_t operator()(std::string_view key) const {
+                return std::hash<std::string_view>{}(key);
+            }
+        };
+
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, std::shared_ptr<const Response>, KeyHasher, std::equal_to<>> responses_;
+        uint64_t version_ = 0;
+        size_t bytes_ = 0;
+        std::atomic<uint64_t> hits_ = 0;
+        std::atomic<uint64_t> misses_ = 0;
+
+        void ClearLocked();
+    };
+}
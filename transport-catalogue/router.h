@@ -29,6 +29,12 @@ public:
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
+    size_t GetRoutesTableBytes() const;
+
+    size_t GetRelaxationCount() const {
+        return relaxation_count_;
+    }
+
 private:
     struct RouteInternalData {
         Weight weight;
@@ -53,31 +59,36 @@ private:
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
+    bool RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
                     const RouteInternalData& route_to) {
         auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
         const Weight candidate_weight = route_from.weight + route_to.weight;
         if (!route_relaxing || candidate_weight < route_relaxing->weight) {
             route_relaxing = {candidate_weight,
                               route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+            return true;
         }
+        return false;
     }
 
     void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
+        size_t relaxation_count = 0;
         for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
             if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
                 for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
                     if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+                        relaxation_count += RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
                     }
                 }
             }
         }
+        relaxation_count_ += relaxation_count;
     }
 
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
     RoutesInternalData routes_internal_data_;
+    size_t relaxation_count_ = 0;
 };
 
 template <typename Weight>
@@ -94,6 +105,15 @@ Router<Weight>::Router(const Graph& graph)
     }
 }
 
+template <typename Weight>
+size_t Router<Weight>::GetRoutesTableBytes() const {
+    size_t bytes = routes_internal_data_.capacity() * sizeof(typename RoutesInternalData::value_type);
+    for (const auto& routes_from : routes_internal_data_) {
+        bytes += routes_from.capacity() * sizeof(typename RoutesInternalData::value_type::value_type);
+    }
+    return bytes;
+}
+
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
@@ -0,0 +1,324 @@
+#include "server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <streambuf>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+namespace server {
+    using namespace std::literals;
+
+    namespace {
+        // Буфер потока поверх файлового дескриптора подключения
+        class FdStreamBuf : public std::streambuf {
+        public:
+            explicit FdStreamBuf(int fd)
+                : fd_(fd) {
+                setg(input_, input_, input_);
+            }
+
+        protected:
+            int_type underflow() override {
+                ssize_t count;
+                do {
+                    count = ::read(fd_, input_, sizeof(input_));
+                } while (count < 0 && errno == EINTR);
+                if (count <= 0) {
+                    return traits_type::eof();
+                }
+                setg(input_, input_, input_ + count);
+                return traits_type::to_int_type(*gptr());
+            }
+
+            std::streamsize xsputn(const char* data, std::streamsize count) override {
+                std::streamsize written = 0;
+                while (written < count) {
+                    const ssize_t result = ::send(fd_, data + written, static_cast<size_t>(count - written),
+                                                  MSG_NOSIGNAL);
+                    if (result < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        break;
+                    }
+                    written += result;
+                }
+                return written;
+            }
+
+            int_type overflow(int_type ch) override {
+                if (traits_type::eq_int_type(ch, traits_type::eof())) {
+                    return traits_type::not_eof(ch);
+                }
+                const char c = traits_type::to_char_type(ch);
+                return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+            }
+
+        private:
+            int fd_;
+            char input_[1 << 16];
+        };
+
+        class FileDescriptor {
+        public:
+            explicit FileDescriptor(int fd)
+                : fd_(fd) {}
+
+            FileDescriptor(const FileDescriptor&) = delete;
+
+            FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+            ~FileDescriptor() {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                }
+            }
+
+            int Get() const {
+                return fd_;
+            }
+
+        private:
+            int fd_;
+        };
+
+        bool IsBlank(const std::string& line) {
+            return line.find_first_not_of(" \t\r"sv) == std::string::npos;
+        }
+
+        void ProcessLine(const jsonreader::JSONReader& reader, requesthandler::RequestHandler& handler,
+                         const std::string& line) {
+            std::optional<int> request_id;
+            try {
+                const json::Document document = json::Load(line);
+                const json::Dict& request = document.GetRoot().AsDict();
+                if (const auto id = request.find("id"s); id != request.end() && id->second.IsInt()) {
+                    request_id = id->second.AsInt();
+                }
+                if (reader.ProcessStatRequest(request, handler)) {
+                    return;
+                }
+                if (request_id) {
+                    handler.PrepareError(*request_id, "unknown request type"s);
+                }
+                else {
+                    handler.PrepareError("unknown request type"s);
+                }
+            }
+            catch (const std::exception& e) {
+                if (request_id) {
+                    handler.PrepareError(*request_id, e.what());
+                }
+                else {
+                    handler.PrepareError(e.what());
+                }
+            }
+        }
+
+        [[noreturn]] void ThrowSystemError(const char* what) {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+
+        // Больше подключений сервер одновременно не обслуживает: следующие ждут в очереди сокета
+        constexpr size_t MAX_CONCURRENT_CONNECTIONS = 64;
+        // Пауза перед повтором accept после нехватки ресурсов; удваивается до ACCEPT_MAX_RETRY_DELAY
+        constexpr std::chrono::milliseconds ACCEPT_RETRY_DELAY{10};
+        constexpr std::chrono::milliseconds ACCEPT_MAX_RETRY_DELAY{1000};
+
+        // Ошибки accept, после которых сокет остаётся рабочим: кончились дескрипторы
+        // или клиент отключился, не дождавшись принятия
+        bool IsTransientAcceptError(int error) {
+            return error == EMFILE || error == ENFILE || error == ECONNABORTED || error == ENOBUFS
+                   || error == ENOMEM;
+        }
+
+        void ServeConnection(const jsonreader::JSONReader& reader, const FileDescriptor& connection) {
+            try {
+                FdStreamBuf buffer(connection.Get());
+                std::istream input(&buffer);
+                std::ostream output(&buffer);
+                ServeStream(reader, input, output);
+            }
+            catch (const std::exception& e) {
+                // Ошибка одного подключения не должна останавливать сервер
+                std::cerr << "connection error: "sv << e.what() << std::endl;
+            }
+        }
+
+        /*
+         * Потоки, обслуживающие подключения. Их число ограничивает число одновременных подключений,
+         * а созданы они один раз, поэтому буферы трассировки потоков не копятся.
+         * Деструктор закрывает открытые подключения и дожидается потоков: после него reader
+         * больше не используется
+         */
+        class ConnectionWorkers {
+        public:
+            ConnectionWorkers(const jsonreader::JSONReader& reader, size_t worker_count)
+                : reader_(reader), active_connections_(worker_count, -1), idle_workers_(worker_count) {
+                workers_.reserve(worker_count);
+                for (size_t i = 0; i < worker_count; ++i) {
+                    workers_.emplace_back([this, i] {
+                        tracing::SetThreadName("connection worker "s + std::to_string(i));
+                        WorkerLoop(i);
+                    });
+                }
+            }
+
+            ConnectionWorkers(const ConnectionWorkers&) = delete;
+
+            ConnectionWorkers& operator=(const ConnectionWorkers&) = delete;
+
+            ~ConnectionWorkers() {
+                {
+                    std::lock_guard lock(mutex_);
+                    stopping_ = true;
+                    pending_.clear();
+                    // Чтение и запись обслуживаемых подключений сразу завершатся, и потоки освободятся
+                    for (const int connection : active_connections_) {
+                        if (connection >= 0) {
+                            ::shutdown(connection, SHUT_RDWR);
+                        }
+                    }
+                }
+                changed_.notify_all();
+                for (std::thread& worker : workers_) {
+                    worker.join();
+                }
+            }
+
+            // Ждёт, пока какой-нибудь поток сможет взять новое подключение
+            void WaitForIdleWorker() {
+                std::unique_lock lock(mutex_);
+                changed_.wait(lock, [this] {
+                    return idle_workers_ > pending_.size();
+                });
+            }
+
+            void Serve(std::unique_ptr<FileDescriptor> connection) {
+                {
+                    std::lock_guard lock(mutex_);
+                    pending_.push_back(std::move(connection));
+                }
+                changed_.notify_all();
+            }
+
+        private:
+            const jsonreader::JSONReader& reader_;
+            std::mutex mutex_;
+            std::condition_variable changed_;
+            std::deque<std::unique_ptr<FileDescriptor>> pending_;
+            // Дескриптор, который обслуживает каждый поток, или -1
+            std::vector<int> active_connections_;
+            size_t idle_workers_;
+            bool stopping_ = false;
+            std::vector<std::thread> workers_;
+
+            void WorkerLoop(size_t worker_index) {
+                while (true) {
+                    std::unique_ptr<FileDescriptor> connection;
+                    {
+                        std::unique_lock lock(mutex_);
+                        changed_.wait(lock, [this] {
+                            return stopping_ || !pending_.empty();
+                        });
+                        if (stopping_) {
+                            return;
+                        }
+                        connection = std::move(pending_.front());
+                        pending_.pop_front();
+                        active_connections_[worker_index] = connection->Get();
+                        --idle_workers_;
+                    }
+                    ServeConnection(reader_, *connection);
+                    {
+                        // Дескриптор снимается с учёта до закрытия, чтобы деструктор не закрыл
+                        // на чтение чужое подключение, получившее тот же номер
+                        std::lock_guard lock(mutex_);
+                        active_connections_[worker_index] = -1;
+                        ++idle_workers_;
+                    }
+                    changed_.notify_all();
+                }
+            }
+        };
+    }
+
+    void ServeStream(const jsonreader::JSONReader& reader, std::istream& input, std::ostream& output) {
+        requesthandler::RequestHandler handler(reader.GetRequestHandler(), output, requesthandler::OutputMode::LINES);
+        std::string line;
+        while (std::getline(input, line)) {
+            if (IsBlank(line)) {
+                continue;
+            }
+            ProcessLine(reader, handler, line);
+            // Пока во входном буфере есть следующие запросы, ответы копятся и уходят одним блоком
+            if (input.rdbuf()->in_avail() <= 0) {
+                handler.Flush();
+            }
+        }
+        handler.Finish();
+    }
+
+    void ServeUnixSocket(const jsonreader::JSONReader& reader, const std::string& socket_path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::invalid_argument("Socket path is too long: "s + socket_path);
+        }
+        std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+        const FileDescriptor listener(::socket(AF_UNIX, SOCK_STREAM, 0));
+        if (listener.Get() < 0) {
+            ThrowSystemError("socket");
+        }
+        ::unlink(socket_path.c_str());
+        if (::bind(listener.Get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+            ThrowSystemError("bind");
+        }
+        if (::listen(listener.Get(), SOMAXCONN) < 0) {
+            ThrowSystemError("listen");
+        }
+
+        // Каждое подключение обслуживается своим потоком, чтобы молчащий клиент не задерживал остальных.
+        // Справочник после загрузки только читается, а общий кэш ответов защищён своим мьютексом
+        ConnectionWorkers workers(reader, MAX_CONCURRENT_CONNECTIONS);
+        std::chrono::milliseconds retry_delay = ACCEPT_RETRY_DELAY;
+        while (true) {
+            workers.WaitForIdleWorker();
+            auto connection = std::make_unique<FileDescriptor>(::accept(listener.Get(), nullptr, nullptr));
+            if (connection->Get() < 0) {
+                const int error = errno;
+                if (error == EINTR) {
+                    continue;
+                }
+                if (!IsTransientAcceptError(error)) {
+                    ThrowSystemError("accept");
+                }
+                std::cerr << "accept: "sv << std::generic_category().message(error) << ", retrying in "sv
+                          << retry_delay.count() << " ms"sv << std::endl;
+                std::this_thread::sleep_for(retry_delay);
+                retry_delay = std::min(retry_delay * 2, ACCEPT_MAX_RETRY_DELAY);
+                continue;
+            }
+            retry_delay = ACCEPT_RETRY_DELAY;
+            workers.Serve(std::move(connection));
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+#include "json_reader.h"
+#include "transport_catalogue.h"
+
+namespace server {
+    /*
+     * Режим сервера: база загружается один раз, после чего запросы к справочнику
+     * читаются построчно в формате NDJSON (один JSON-объект stat-запроса в строке).
+     * На каждую непустую строку выводится ровно одна строка с ответом.
+     */
+
+    // Обслуживает запросы из input до конца потока. Запомненные ответы общие для всех
+    // вызовов с одним reader, см. JSONReader::GetRequestHandler
+    void ServeStream(const jsonreader::JSONReader& reader, std::istream& input, std::ostream& output);
+
+    // Слушает Unix-сокет по пути socket_path и обслуживает подключения параллельно, не больше
+    // фиксированного числа одновременно. Если accept завершается неустранимой ошибкой, закрывает
+    // открытые подключения, дожидается их обработчиков и выбрасывает std::system_error
+    void ServeUnixSocket(const jsonreader::JSONReader& reader, const std::string& socket_path);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace metrics {
+    /*
+     * Счётчик, который часто увеличивают из разных потоков и редко читают. Каждый поток пишет
+     * в свою ячейку на отдельной кэш-линии, поэтому потоки не конкурируют за одну линию;
+     * при чтении ячейки суммируются. Потоков больше SLOT_COUNT делят ячейки по кругу
+     */
+    class ShardedCounter {
+    public:
+        void Add(uint64_t value) {
+            slots_[GetThreadSlot()].value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        uint64_t Get() const {
+            uint64_t total = 0;
+            for (const Slot& slot : slots_) {
+                total += slot.value.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+    private:
+        static constexpr size_t SLOT_COUNT = 16;
+        static constexpr size_t CACHE_LINE_SIZE = 64;
+
+        struct alignas(CACHE_LINE_SIZE) Slot {
+            std::atomic<uint64_t> value = 0;
+        };
+
+        std::array<Slot, SLOT_COUNT> slots_{};
+
+        // Ячейка закрепляется за потоком при первом обращении и общая для всех счётчиков
+        static size_t GetThreadSlot() {
+            static std::atomic<size_t> next_slot = 0;
+            thread_local const size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % SLOT_COUNT;
+            return slot;
+        }
+    };
+}
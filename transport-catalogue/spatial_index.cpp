@@ -0,0 +1,86 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace svg {
+    namespace {
+        // Среднее число записей на ячейку, под которое подбирается размер сетки
+        constexpr double ENTRIES_PER_CELL = 4.;
+        constexpr size_t MAX_GRID_SIDE = 512;
+    }
+
+    SpatialIndex::SpatialIndex(const Document& document)
+        : unbounded_objects_(document.GetUnboundedObjects()) {
+        document.VisitBounds([this](uint32_t object, const Rect& bounds) {
+            entries_.push_back({object, bounds});
+        });
+        if (entries_.empty()) {
+            cells_.resize(1);
+            return;
+        }
+
+        extent_ = entries_.front().bounds;
+        double total_width = 0;
+        double total_height = 0;
+        for (const Entry& entry : entries_) {
+            extent_.left = std::min(extent_.left, entry.bounds.left);
+            extent_.top = std::min(extent_.top, entry.bounds.top);
+            extent_.right = std::max(extent_.right, entry.bounds.right);
+            extent_.bottom = std::max(extent_.bottom, entry.bounds.bottom);
+            total_width += entry.bounds.right - entry.bounds.left;
+            total_height += entry.bounds.bottom - entry.bounds.top;
+        }
+        const double extent_width = extent_.right - extent_.left;
+        const double extent_height = extent_.bottom - extent_.top;
+
+        // Ячейка не меньше среднего объекта, иначе крупные подписи попадают в десятки ячеек
+        const double side_by_count = std::ceil(std::sqrt(entries_.size() / ENTRIES_PER_CELL));
+        columns_ = static_cast<size_t>(std::clamp(
+            std::min(side_by_count, std::floor(extent_width * entries_.size() / total_width)), 1., 1. * MAX_GRID_SIDE));
+        rows_ = static_cast<size_t>(std::clamp(
+            std::min(side_by_count, std::floor(extent_height * entries_.size() / total_height)), 1., 1. * MAX_GRID_SIDE));
+        cell_width_ = std::max(extent_width / columns_, 1e-9);
+        cell_height_ = std::max(extent_height / rows_, 1e-9);
+
+        cells_.resize(columns_ * rows_);
+        for (uint32_t entry_index = 0; entry_index < entries_.size(); ++entry_index) {
+            const Rect& bounds = entries_[entry_index].bounds;
+            for (size_t row = GetRow(bounds.top); row <= GetRow(bounds.bottom); ++row) {
+                for (size_t column = GetColumn(bounds.left); column <= GetColumn(bounds.right); ++column) {
+                    cells_[row * columns_ + column].push_back(entry_index);
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> SpatialIndex::Query(const Rect& region) const {
+        std::vector<uint32_t> result = unbounded_objects_;
+        if (!entries_.empty() && region.Intersects(extent_)) {
+            for (size_t row = GetRow(region.top); row <= GetRow(region.bottom); ++row) {
+                for (size_t column = GetColumn(region.left); column <= GetColumn(region.right); ++column) {
+                    for (const uint32_t entry_index : cells_[row * columns_ + column]) {
+                        const Entry& entry = entries_[entry_index];
+                        if (entry.bounds.Intersects(region)) {
+                            result.push_back(entry.object);
+                        }
+                    }
+                }
+            }
+        }
+        // Объект мог попасть в результат несколькими отрезками или из нескольких ячеек
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    size_t SpatialIndex::GetColumn(double x) const {
+        const double column = std::floor((x - extent_.left) / cell_width_);
+        return static_cast<size_t>(std::clamp(column, 0., static_cast<double>(columns_ - 1)));
+    }
+
+    size_t SpatialIndex::GetRow(double y) const {
+        const double row = std::floor((y - extent_.top) / cell_height_);
+        return static_cast<size_t>(std::clamp(row, 0., static_cast<double>(rows_ - 1)));
+    }
+}
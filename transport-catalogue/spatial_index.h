@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "svg.h"
+
+namespace svg {
+    /*
+     * Равномерная сетка над габаритами объектов svg::Document. Ломаные попадают в сетку
+     * отдельными отрезками, поэтому длинная линия через весь город занимает только
+     * ячейки вдоль своего пути. Запрос возвращает индексы объектов документа,
+     * пересекающих область, в порядке вывода документа.
+     */
+    class SpatialIndex {
+    public:
+        explicit SpatialIndex(const Document& document);
+
+        std::vector<uint32_t> Query(const Rect& region) const;
+
+    private:
+        struct Entry {
+            uint32_t object;
+            Rect bounds;
+        };
+
+        std::vector<Entry> entries_;
+        std::vector<std::vector<uint32_t>> cells_;
+        std::vector<uint32_t> unbounded_objects_;
+        Rect extent_;
+        size_t columns_ = 1;
+        size_t rows_ = 1;
+        double cell_width_ = 1;
+        double cell_height_ = 1;
+
+        size_t GetColumn(double x) const;
+
+        size_t GetRow(double y) const;
+    };
+}
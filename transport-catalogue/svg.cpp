@@ -1,44 +1,127 @@
 #include "svg.h"
 
+#include <algorithm>
+
+#include "thread_pool.h"
+
 namespace svg {
     using namespace std::literals;
 
-    std::ostream& operator<<(std::ostream& out, StrokeLineCap value) {
-        std::string_view sv;
-        switch (value) {
-        case StrokeLineCap::BUTT:
-            sv = "butt"sv;
-            break;
-        case StrokeLineCap::ROUND:
-            sv = "round"sv;
-            break;
-        case StrokeLineCap::SQUARE:
-            sv = "square"sv;
-            break;
+    namespace {
+        std::string_view ToStringView(StrokeLineCap value) {
+            switch (value) {
+            case StrokeLineCap::BUTT:
+                return "butt"sv;
+            case StrokeLineCap::ROUND:
+                return "round"sv;
+            case StrokeLineCap::SQUARE:
+                return "square"sv;
+            }
+            return {};
         }
-        return out << sv;
+
+        std::string_view ToStringView(StrokeLineJoin value) {
+            switch (value) {
+            case StrokeLineJoin::ARCS:
+                return "arcs"sv;
+            case StrokeLineJoin::BEVEL:
+                return "bevel"sv;
+            case StrokeLineJoin::MITER:
+                return "miter"sv;
+            case StrokeLineJoin::MITER_CLIP:
+                return "miter-clip"sv;
+            case StrokeLineJoin::ROUND:
+                return "round"sv;
+            }
+            return {};
+        }
+
+        void RenderCircle(io::OutputBuffer& out, Point center, double radius, const PathStyle& style) {
+            out << "<circle cx=\""sv << center.x << "\" cy=\""sv << center.y << "\" "sv;
+            out << "r=\""sv << radius << "\" "sv;
+            detail::RenderPathStyle(out, style);
+            out << "/>"sv;
+        }
+
+        void RenderPolyline(io::OutputBuffer& out, const Point* points, size_t point_count, const PathStyle& style) {
+            out << "<polyline points=\""sv;
+            for (size_t i = 0; i < point_count; ++i) {
+                if (i > 0) {
+                    out << ' ';
+                }
+                out << points[i].x << ',' << points[i].y;
+            }
+            out << "\" "sv;
+            detail::RenderPathStyle(out, style);
+            out << "/>"sv;
+        }
+
+        void RenderText(io::OutputBuffer& out, const PathStyle& style, Point position, Point offset,
+                        uint32_t font_size, std::string_view font_family, std::string_view font_weight,
+                        std::string_view data) {
+            out << "<text "sv;
+            detail::RenderPathStyle(out, style);
+            using detail::RenderAttr;
+            RenderAttr(out, " x"sv, position.x);
+            RenderAttr(out, " y"sv, position.y);
+            RenderAttr(out, " dx"sv, offset.x);
+            RenderAttr(out, " dy"sv, offset.y);
+            RenderAttr(out, " font-size"sv, font_size);
+            if (!font_family.empty()) {
+                RenderAttr(out, " font-family"sv, font_family);
+            }
+            if (!font_weight.empty()) {
+                RenderAttr(out, " font-weight"sv, font_weight);
+            }
+            out.Put('>');
+            detail::HtmlEncodeString(out, data);
+            out << "</text>"sv;
+        }
+
+        // Документ с меньшим числом объектов выводится одним потоком
+        constexpr size_t PARALLEL_RENDER_THRESHOLD = 8192;
+        constexpr size_t OBJECTS_PER_RENDER_CHUNK = 2048;
+        // Сколько готовых частей на поток может ждать вывода. Части выводятся волнами,
+        // поэтому в памяти не копится несжатая копия всего документа
+        constexpr size_t RENDER_CHUNKS_IN_FLIGHT_PER_THREAD = 2;
+
+        // Средняя ширина символа относительно размера шрифта, с запасом
+        constexpr double CHAR_WIDTH_RATIO = 0.7;
+
+        Rect ExpandedRect(Point a, Point b, double margin) {
+            return {std::min(a.x, b.x) - margin, std::min(a.y, b.y) - margin,
+                    std::max(a.x, b.x) + margin, std::max(a.y, b.y) + margin};
+        }
+
+        double GetStrokeMargin(const PathStyle& style) {
+            return style.stroke_width && style.stroke_color ? *style.stroke_width / 2 : 0.;
+        }
+
+        void RenderHeader(io::OutputBuffer& out) {
+            out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv;
+        }
+
+        template <typename T>
+        void HashCombine(size_t& seed, const std::optional<T>& value) {
+            const size_t hash = value ? std::hash<T>{}(*value) : 0x9e3779b9;
+            seed ^= hash + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+    }
+
+    std::ostream& operator<<(std::ostream& out, StrokeLineCap value) {
+        return out << ToStringView(value);
+    }
+
+    io::OutputBuffer& operator<<(io::OutputBuffer& out, StrokeLineCap value) {
+        return out << ToStringView(value);
     }
 
     std::ostream& operator<<(std::ostream& out, StrokeLineJoin value) {
-        std::string_view sv;
-        switch (value) {
-        case StrokeLineJoin::ARCS:
-            sv = "arcs"sv;
-            break;
-        case StrokeLineJoin::BEVEL:
-            sv = "bevel"sv;
-            break;
-        case StrokeLineJoin::MITER:
-            sv = "miter"sv;
-            break;
-        case StrokeLineJoin::MITER_CLIP:
-            sv = "miter-clip"sv;
-            break;
-        case StrokeLineJoin::ROUND:
-            sv = "round"sv;
-            break;
-        }
-        return out << sv;
+        return out << ToStringView(value);
+    }
+
+    io::OutputBuffer& operator<<(io::OutputBuffer& out, StrokeLineJoin value) {
+        return out << ToStringView(value);
     }
 
     void Object::Render(const RenderContext& context) const {
@@ -47,7 +130,7 @@ namespace svg {
         // Делегируем вывод тэга своим подклассам
         RenderObject(context);
 
-        context.out << std::endl;
+        context.out.Put('\n');
     }
 
     // Circle
@@ -63,11 +146,7 @@ namespace svg {
     }
 
     void Circle::RenderObject(const RenderContext& context) const {
-        auto& out = context.out;
-        out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
-        out << "r=\""sv << radius_ << "\" "sv;
-        RenderAttrs(out);
-        out << "/>"sv;
+        RenderCircle(context.out, center_, radius_, GetPathStyle());
     }
 
     // Polyline
@@ -78,21 +157,7 @@ namespace svg {
     }
 
     void Polyline::RenderObject(const RenderContext& context) const {
-        auto& out = context.out;
-        out << "<polyline points=\""sv;
-        bool first = true;
-        for (const Point& p : points_) {
-            if (first) {
-                first = false;
-            }
-            else {
-                out << ' ';
-            }
-            out << p.x << ',' << p.y;
-        }
-        out << "\" "sv;
-        RenderAttrs(out);
-        out << "/>"sv;
+        RenderPolyline(context.out, points_.data(), points_.size(), GetPathStyle());
     }
 
     // Text
@@ -128,46 +193,315 @@ namespace svg {
     }
 
     void Text::RenderObject(const RenderContext& context) const {
-        auto& out = context.out;
-        out << "<text "sv;
-        RenderAttrs(out);
-        using detail::RenderAttr;
-        RenderAttr(out, " x"sv, position_.x);
-        RenderAttr(out, " y"sv, position_.y);
-        RenderAttr(out, " dx"sv, offset_.x);
-        RenderAttr(out, " dy"sv, offset_.y);
-        RenderAttr(out, " font-size"sv, font_size_);
-        if (!font_family_.empty()) {
-            RenderAttr(out, " font-family"sv, font_family_);
-        }
-        if (!font_weight_.empty()) {
-            RenderAttr(out, " font-weight"sv, font_weight_);
-        }
-        out.put('>');
-        detail::HtmlEncodeString(out, data_);
-        out << "</text>"sv;
+        RenderText(context.out, GetPathStyle(), position_, offset_, font_size_, font_family_, font_weight_, data_);
     }
 
     // Document
 
+    void Document::Add(const Circle& circle) {
+        AddCircle(circle.center_, circle.radius_, InternStyle(circle.GetPathStyle()));
+    }
+
+    void Document::Add(const Polyline& polyline) {
+        AddPolyline(polyline.points_, InternStyle(polyline.GetPathStyle()));
+    }
+
+    void Document::Add(const Text& text) {
+        const TextStyle style{text.offset_, text.font_size_, InternStyle(text.GetPathStyle()),
+                              InternString(text.font_family_), InternString(text.font_weight_)};
+        AddText(text.position_, text.data_, style);
+    }
+
+    void Document::AddCircle(Point center, double radius, StyleId style) {
+        objects_.push_back({ObjectKind::CIRCLE, static_cast<uint32_t>(circles_.size())});
+        circles_.push_back({center, radius, style});
+    }
+
+    void Document::AddPolyline(std::span<const Point> points, StyleId style) {
+        objects_.push_back({ObjectKind::POLYLINE, static_cast<uint32_t>(polylines_.size())});
+        polylines_.push_back({style, static_cast<uint32_t>(points_.size()), static_cast<uint32_t>(points.size())});
+        points_.insert(points_.end(), points.begin(), points.end());
+    }
+
+    void Document::AddText(Point position, std::string_view data, const TextStyle& style) {
+        objects_.push_back({ObjectKind::TEXT, static_cast<uint32_t>(texts_.size())});
+        texts_.push_back({position, style.offset, style.font_size, style.path_style, style.font_family,
+                          style.font_weight, static_cast<uint32_t>(text_data_.size()),
+                          static_cast<uint32_t>(data.size())});
+        text_data_.append(data);
+    }
+
     void Document::AddPtr(std::unique_ptr<Object>&& obj) {
-        objects_.push_back(std::move(obj));
+        // Известные фигуры переводятся в компактные записи, остальные объекты хранятся как есть
+        if (const auto* circle = dynamic_cast<const Circle*>(obj.get())) {
+            Add(*circle);
+        }
+        else if (const auto* polyline = dynamic_cast<const Polyline*>(obj.get())) {
+            Add(*polyline);
+        }
+        else if (const auto* text = dynamic_cast<const Text*>(obj.get())) {
+            Add(*text);
+        }
+        else {
+            objects_.push_back({ObjectKind::OTHER, static_cast<uint32_t>(other_objects_.size())});
+            other_objects_.push_back(std::move(obj));
+        }
+    }
+
+    void Document::Append(Document&& other) {
+        std::vector<uint32_t> style_ids;
+        style_ids.reserve(other.styles_.size());
+        for (const PathStyle& style : other.styles_) {
+            style_ids.push_back(InternStyle(style));
+        }
+        std::vector<uint32_t> string_ids;
+        string_ids.reserve(other.strings_.size());
+        for (const std::string& value : other.strings_) {
+            string_ids.push_back(InternString(value));
+        }
+
+        const auto point_offset = static_cast<uint32_t>(points_.size());
+        const auto text_offset = static_cast<uint32_t>(text_data_.size());
+        const auto circle_offset = static_cast<uint32_t>(circles_.size());
+        const auto polyline_offset = static_cast<uint32_t>(polylines_.size());
+        const auto text_record_offset = static_cast<uint32_t>(texts_.size());
+        const auto other_offset = static_cast<uint32_t>(other_objects_.size());
+
+        for (CircleRecord circle : other.circles_) {
+            circle.style = style_ids[circle.style];
+            circles_.push_back(circle);
+        }
+        for (PolylineRecord polyline : other.polylines_) {
+            polyline.style = style_ids[polyline.style];
+            polyline.first_point += point_offset;
+            polylines_.push_back(polyline);
+        }
+        for (TextRecord text : other.texts_) {
+            text.style = style_ids[text.style];
+            text.font_family = string_ids[text.font_family];
+            text.font_weight = string_ids[text.font_weight];
+            text.data_offset += text_offset;
+            texts_.push_back(text);
+        }
+        for (std::unique_ptr<Object>& object : other.other_objects_) {
+            other_objects_.push_back(std::move(object));
+        }
+        points_.insert(points_.end(), other.points_.begin(), other.points_.end());
+        text_data_.append(other.text_data_);
+
+        objects_.reserve(objects_.size() + other.objects_.size());
+        for (ObjectRef object : other.objects_) {
+            switch (object.kind) {
+            case ObjectKind::CIRCLE:
+                object.index += circle_offset;
+                break;
+            case ObjectKind::POLYLINE:
+                object.index += polyline_offset;
+                break;
+            case ObjectKind::TEXT:
+                object.index += text_record_offset;
+                break;
+            case ObjectKind::OTHER:
+                object.index += other_offset;
+                break;
+            }
+            objects_.push_back(object);
+        }
+        other = Document();
     }
 
     void Document::Render(std::ostream& out) const {
-        out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
-        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
+        io::OutputBuffer buffer(out);
+        Render(buffer);
+        buffer.Flush();
+    }
+
+    void Document::Render(io::OutputBuffer& out) const {
+        RenderHeader(out);
+        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv;
+        RenderObjects(out);
+        out << "</svg>"sv;
+    }
+
+    void Document::RenderObjects(io::OutputBuffer& out) const {
+        if (objects_.size() < PARALLEL_RENDER_THRESHOLD || threading::GetHardwareConcurrency() <= 1) {
+            RenderContext ctx{out, 2, 2};
+            for (const ObjectRef& object : objects_) {
+                RenderObject(object, ctx);
+            }
+            return;
+        }
+
+        // Части выводятся в отдельные буферы в том же режиме экранирования и передаются в out по порядку.
+        // Одновременно готовится не больше window частей: каждая волна уходит в out (например, в сжатие),
+        // прежде чем начинается следующая
+        const size_t chunk_count = (objects_.size() + OBJECTS_PER_RENDER_CHUNK - 1) / OBJECTS_PER_RENDER_CHUNK;
+        const size_t window = std::min(chunk_count,
+                                       RENDER_CHUNKS_IN_FLIGHT_PER_THREAD * threading::GetHardwareConcurrency());
+        std::vector<std::string> chunks(window);
+        for (size_t first_chunk = 0; first_chunk < chunk_count; first_chunk += window) {
+            const size_t wave_size = std::min(window, chunk_count - first_chunk);
+            threading::ParallelFor(wave_size, [&](size_t wave_index) {
+                io::OutputBuffer chunk_out;
+                chunk_out.SetJsonEscaping(out.IsJsonEscaping());
+                RenderContext ctx{chunk_out, 2, 2};
+                const size_t begin = (first_chunk + wave_index) * OBJECTS_PER_RENDER_CHUNK;
+                const size_t end = std::min(begin + OBJECTS_PER_RENDER_CHUNK, objects_.size());
+                for (size_t i = begin; i < end; ++i) {
+                    RenderObject(objects_[i], ctx);
+                }
+                chunks[wave_index] = chunk_out.Take();
+            });
+            for (size_t wave_index = 0; wave_index < wave_size; ++wave_index) {
+                out.WriteRaw(chunks[wave_index]);
+                chunks[wave_index] = std::string();
+            }
+        }
+    }
+
+    void Document::Render(io::OutputBuffer& out, const std::vector<uint32_t>& object_indices,
+                          const Rect& view_box) const {
+        RenderHeader(out);
+        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\" viewBox=\""sv;
+        out << view_box.left << ' ' << view_box.top << ' ' << view_box.right - view_box.left << ' '
+            << view_box.bottom - view_box.top << "\">\n"sv;
         RenderContext ctx{out, 2, 2};
-        for (const auto& obj : objects_) {
-            obj->Render(ctx);
+        for (const uint32_t index : object_indices) {
+            RenderObject(objects_[index], ctx);
         }
         out << "</svg>"sv;
     }
 
+    void Document::VisitBounds(const std::function<void(uint32_t, const Rect&)>& visitor) const {
+        for (uint32_t index = 0; index < objects_.size(); ++index) {
+            const ObjectRef& object = objects_[index];
+            switch (object.kind) {
+            case ObjectKind::CIRCLE: {
+                const CircleRecord& circle = circles_[object.index];
+                const double margin = circle.radius + GetStrokeMargin(styles_[circle.style]);
+                visitor(index, ExpandedRect(circle.center, circle.center, margin));
+                break;
+            }
+            case ObjectKind::POLYLINE: {
+                const PolylineRecord& polyline = polylines_[object.index];
+                const double margin = GetStrokeMargin(styles_[polyline.style]);
+                const Point* points = points_.data() + polyline.first_point;
+                if (polyline.point_count == 1) {
+                    visitor(index, ExpandedRect(points[0], points[0], margin));
+                }
+                for (uint32_t i = 1; i < polyline.point_count; ++i) {
+                    visitor(index, ExpandedRect(points[i - 1], points[i], margin));
+                }
+                break;
+            }
+            case ObjectKind::TEXT: {
+                // Текст начинается в точке привязки и поднимается над базовой линией на размер шрифта
+                const TextRecord& text = texts_[object.index];
+                const Point anchor{text.position.x + text.offset.x, text.position.y + text.offset.y};
+                const Point far_corner{anchor.x + text.data_size * text.font_size * CHAR_WIDTH_RATIO,
+                                       anchor.y - text.font_size};
+                visitor(index, ExpandedRect(anchor, far_corner,
+                                            GetStrokeMargin(styles_[text.style]) + text.font_size / 4.));
+                break;
+            }
+            case ObjectKind::OTHER:
+                break;
+            }
+        }
+    }
+
+    std::vector<uint32_t> Document::GetUnboundedObjects() const {
+        std::vector<uint32_t> result;
+        for (uint32_t index = 0; index < objects_.size(); ++index) {
+            if (objects_[index].kind == ObjectKind::OTHER) {
+                result.push_back(index);
+            }
+        }
+        return result;
+    }
+
+    Document::StyleId Document::InternStyle(const PathStyle& style) {
+        // Поиск до вставки, чтобы повторяющийся стиль не создавал узел таблицы
+        if (const auto it = style_ids_.find(style); it != style_ids_.end()) {
+            return it->second;
+        }
+        const auto id = static_cast<uint32_t>(styles_.size());
+        styles_.push_back(style);
+        style_ids_.emplace(style, id);
+        return id;
+    }
+
+    Document::StringId Document::InternString(const std::string& value) {
+        if (const auto it = string_ids_.find(value); it != string_ids_.end()) {
+            return it->second;
+        }
+        const auto id = static_cast<uint32_t>(strings_.size());
+        strings_.push_back(value);
+        string_ids_.emplace(value, id);
+        return id;
+    }
+
+    std::string_view Document::GetTextData(const TextRecord& text) const {
+        return std::string_view(text_data_).substr(text.data_offset, text.data_size);
+    }
+
+    void Document::RenderObject(const ObjectRef& object, const RenderContext& context) const {
+        if (object.kind == ObjectKind::OTHER) {
+            other_objects_[object.index]->Render(context);
+            return;
+        }
+
+        context.RenderIndent();
+        switch (object.kind) {
+        case ObjectKind::CIRCLE: {
+            const CircleRecord& circle = circles_[object.index];
+            RenderCircle(context.out, circle.center, circle.radius, styles_[circle.style]);
+            break;
+        }
+        case ObjectKind::POLYLINE: {
+            const PolylineRecord& polyline = polylines_[object.index];
+            RenderPolyline(context.out, points_.data() + polyline.first_point, polyline.point_count,
+                           styles_[polyline.style]);
+            break;
+        }
+        case ObjectKind::TEXT: {
+            const TextRecord& text = texts_[object.index];
+            RenderText(context.out, styles_[text.style], text.position, text.offset, text.font_size,
+                       strings_[text.font_family], strings_[text.font_weight], GetTextData(text));
+            break;
+        }
+        case ObjectKind::OTHER:
+            break;
+        }
+        context.out.Put('\n');
+    }
+
     namespace detail {
-        void HtmlEncodeString(std::ostream& out, std::string_view sv) {
-            for (char c : sv) {
-                switch (c) {
+        void RenderPathStyle(io::OutputBuffer& out, const PathStyle& style) {
+            RenderOptionalAttr(out, "fill"sv, style.fill_color);
+            RenderOptionalAttr(out, " stroke"sv, style.stroke_color);
+            RenderOptionalAttr(out, " stroke-width"sv, style.stroke_width);
+            RenderOptionalAttr(out, " stroke-linecap"sv, style.stroke_line_cap);
+            RenderOptionalAttr(out, " stroke-linejoin"sv, style.stroke_line_join);
+        }
+
+        size_t PathStyleHasher::operator()(const PathStyle& style) const {
+            size_t seed = 0;
+            HashCombine(seed, style.fill_color);
+            HashCombine(seed, style.stroke_color);
+            HashCombine(seed, style.stroke_width);
+            HashCombine(seed, style.stroke_line_cap);
+            HashCombine(seed, style.stroke_line_join);
+            return seed;
+        }
+
+        void HtmlEncodeString(io::OutputBuffer& out, std::string_view sv) {
+            // Участки без спецсимволов копируются целиком, посимвольно разбираются только сами спецсимволы
+            size_t run_begin = 0;
+            for (size_t pos = sv.find_first_of("\"<>&'"sv); pos != std::string_view::npos;
+                 pos = sv.find_first_of("\"<>&'"sv, run_begin)) {
+                out.Write(sv.substr(run_begin, pos - run_begin));
+                switch (sv[pos]) {
                 case '"':
                     out << "&quot;"sv;
                     break;
@@ -180,13 +514,12 @@ namespace svg {
                 case '&':
                     out << "&amp;"sv;
                     break;
-                case '\'':
-                    out << "&apos;"sv;
-                    break;
                 default:
-                    out.put(c);
+                    out << "&apos;"sv;
                 }
+                run_begin = pos + 1;
             }
+            out.Write(sv.substr(run_begin));
         }
     }
 }
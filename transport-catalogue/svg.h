@@ -1,37 +1,47 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
+#include "output_buffer.h"
+
 namespace svg {
     namespace detail {
         template <typename T>
-        inline void RenderValue(std::ostream& out, const T& value) {
+        inline void RenderValue(io::OutputBuffer& out, const T& value) {
             out << value;
         }
 
-        void HtmlEncodeString(std::ostream& out, std::string_view sv);
+        void HtmlEncodeString(io::OutputBuffer& out, std::string_view sv);
 
         template <>
-        inline void RenderValue<std::string>(std::ostream& out, const std::string& s) {
+        inline void RenderValue<std::string>(io::OutputBuffer& out, const std::string& s) {
+            HtmlEncodeString(out, s);
+        }
+
+        template <>
+        inline void RenderValue<std::string_view>(io::OutputBuffer& out, const std::string_view& s) {
             HtmlEncodeString(out, s);
         }
 
         template <typename AttrType>
-        inline void RenderAttr(std::ostream& out, std::string_view name, const AttrType& value) {
+        inline void RenderAttr(io::OutputBuffer& out, std::string_view name, const AttrType& value) {
             using namespace std::literals;
             out << name << "=\""sv;
             RenderValue(out, value);
-            out.put('"');
+            out.Put('"');
         }
 
         template <typename AttrType>
-        inline void RenderOptionalAttr(std::ostream& out, std::string_view name,
+        inline void RenderOptionalAttr(io::OutputBuffer& out, std::string_view name,
                                        const std::optional<AttrType>& value) {
             if (value) {
                 RenderAttr(out, name, *value);
@@ -50,18 +60,30 @@ namespace svg {
         double y = 0;
     };
 
+    // Прямоугольная область в координатах документа
+    struct Rect {
+        double left = 0;
+        double top = 0;
+        double right = 0;
+        double bottom = 0;
+
+        bool Intersects(const Rect& other) const {
+            return left <= other.right && other.left <= right && top <= other.bottom && other.top <= bottom;
+        }
+    };
+
     using Color = std::string;
     inline const Color NoneColor{"none"};
 
     /*
      * Вспомогательная структура, хранящая контекст для вывода SVG-документа с отступами.
-     * Хранит ссылку на поток вывода, текущее значение и шаг отступа при выводе элемента
+     * Хранит ссылку на буфер вывода, текущее значение и шаг отступа при выводе элемента
      */
     struct RenderContext {
-        RenderContext(std::ostream& out)
+        RenderContext(io::OutputBuffer& out)
             : out(out) {}
 
-        RenderContext(std::ostream& out, int indent_step, int indent = 0)
+        RenderContext(io::OutputBuffer& out, int indent_step, int indent = 0)
             : out(out)
               , indent_step(indent_step)
               , indent(indent) {}
@@ -71,12 +93,10 @@ namespace svg {
         }
 
         void RenderIndent() const {
-            for (int i = 0; i < indent; ++i) {
-                out.put(' ');
-            }
+            out.WriteRepeated(' ', indent);
         }
 
-        std::ostream& out;
+        io::OutputBuffer& out;
         int indent_step = 0;
         int indent = 0;
     };
@@ -104,6 +124,8 @@ namespace svg {
 
     std::ostream& operator<<(std::ostream& out, StrokeLineCap value);
 
+    io::OutputBuffer& operator<<(io::OutputBuffer& out, StrokeLineCap value);
+
     enum class StrokeLineJoin {
         ARCS,
         BEVEL,
@@ -114,45 +136,66 @@ namespace svg {
 
     std::ostream& operator<<(std::ostream& out, StrokeLineJoin value);
 
+    io::OutputBuffer& operator<<(io::OutputBuffer& out, StrokeLineJoin value);
+
+    /*
+     * Свойства контура, общие для всех фигур: цвет заливки, цвет и параметры обводки
+     */
+    struct PathStyle {
+        std::optional<Color> fill_color;
+        std::optional<Color> stroke_color;
+        std::optional<double> stroke_width;
+        std::optional<StrokeLineCap> stroke_line_cap;
+        std::optional<StrokeLineJoin> stroke_line_join;
+
+        bool operator==(const PathStyle& other) const = default;
+    };
+
+    namespace detail {
+        void RenderPathStyle(io::OutputBuffer& out, const PathStyle& style);
+
+        struct PathStyleHasher {
+            size_t operator()(const PathStyle& style) const;
+        };
+    }
+
     template <typename Owner>
     class PathProps {
     public:
         Owner& SetFillColor(Color color) {
-            fill_color_ = std::move(color);
+            style_.fill_color = std::move(color);
             return AsOwner();
         }
 
         Owner& SetStrokeColor(Color color) {
-            stroke_color_ = std::move(color);
+            style_.stroke_color = std::move(color);
             return AsOwner();
         }
 
         Owner& SetStrokeWidth(double width) {
-            stroke_width_ = width;
+            style_.stroke_width = width;
             return AsOwner();
         }
 
         Owner& SetStrokeLineCap(StrokeLineCap line_cap) {
-            stroke_line_cap_ = line_cap;
+            style_.stroke_line_cap = line_cap;
             return AsOwner();
         }
 
         Owner& SetStrokeLineJoin(StrokeLineJoin line_join) {
-            stroke_line_join_ = line_join;
+            style_.stroke_line_join = line_join;
             return AsOwner();
         }
 
+        const PathStyle& GetPathStyle() const {
+            return style_;
+        }
+
     protected:
         ~PathProps() = default;
 
-        void RenderAttrs(std::ostream& out) const {
-            using detail::RenderOptionalAttr;
-            using namespace std::literals;
-            RenderOptionalAttr(out, "fill"sv, fill_color_);
-            RenderOptionalAttr(out, " stroke"sv, stroke_color_);
-            RenderOptionalAttr(out, " stroke-width"sv, stroke_width_);
-            RenderOptionalAttr(out, " stroke-linecap"sv, stroke_line_cap_);
-            RenderOptionalAttr(out, " stroke-linejoin"sv, stroke_line_join_);
+        void RenderAttrs(io::OutputBuffer& out) const {
+            detail::RenderPathStyle(out, style_);
         }
 
     private:
@@ -162,11 +205,7 @@ namespace svg {
             return static_cast<Owner&>(*this);
         }
 
-        std::optional<Color> fill_color_;
-        std::optional<Color> stroke_color_;
-        std::optional<double> stroke_width_;
-        std::optional<StrokeLineCap> stroke_line_cap_;
-        std::optional<StrokeLineJoin> stroke_line_join_;
+        PathStyle style_;
     };
 
     /*
@@ -181,6 +220,8 @@ namespace svg {
         Circle& SetRadius(double radius);
 
     private:
+        friend class Document;
+
         void RenderObject(const RenderContext& context) const override;
 
         Point center_;
@@ -197,6 +238,8 @@ namespace svg {
         Polyline& AddPoint(Point point);
 
     private:
+        friend class Document;
+
         void RenderObject(const RenderContext& context) const override;
         std::vector<Point> points_;
     };
@@ -226,6 +269,8 @@ namespace svg {
         Text& SetData(std::string data);
 
     private:
+        friend class Document;
+
         void RenderObject(const RenderContext& context) const override;
         Point position_;
         Point offset_;
@@ -267,15 +312,133 @@ namespace svg {
         virtual ~Drawable() = default;
     };
 
+    /*
+     * SVG-документ. Круги, ломаные и тексты хранятся не отдельными объектами в куче,
+     * а компактными записями в непрерывных массивах: координаты ломаных и тексты лежат
+     * в общих пулах, а одинаковые наборы свойств контура и шрифты - в общих таблицах,
+     * на которые записи ссылаются по индексу. Прочие наследники Object хранятся как есть.
+     */
     class Document : public ObjectContainer {
     public:
+        // Индексы в таблицах свойств контура и строк документа. Действительны только для документа,
+        // который их выдал
+        using StyleId = uint32_t;
+        using StringId = uint32_t;
+
+        // Оформление надписи, общее для многих текстов: смещение, шрифт и свойства контура
+        struct TextStyle {
+            Point offset;
+            uint32_t font_size = 1;
+            StyleId path_style = 0;
+            StringId font_family = 0;
+            StringId font_weight = 0;
+        };
+
+        using ObjectContainer::Add;
+
+        // Заносит набор свойств контура в таблицу документа; одинаковые наборы получают один индекс
+        StyleId InternStyle(const PathStyle& style);
+
+        StringId InternString(const std::string& value);
+
+        // Добавляют записи фигур напрямую, без промежуточных объектов Circle, Polyline и Text.
+        // Если стили заранее занесены в таблицы, выделения памяти нужны только на рост массивов записей
+        void AddCircle(Point center, double radius, StyleId style);
+
+        void AddPolyline(std::span<const Point> points, StyleId style);
+
+        void AddText(Point position, std::string_view data, const TextStyle& style);
+
+        void Add(const Circle& circle);
+
+        void Add(const Polyline& polyline);
+
+        void Add(const Text& text);
+
         // Добавляет в svg-документ объект-наследник svg::Object
         void AddPtr(std::unique_ptr<Object>&& obj) override;
 
+        // Переносит в конец документа все объекты other в их порядке
+        void Append(Document&& other);
+
         // Выводит в ostream svg-представление документа
         void Render(std::ostream& out) const;
 
+        // Выводит svg-представление документа в буфер.
+        // Большой документ выводится частями параллельно, каждая часть в свой буфер
+        void Render(io::OutputBuffer& out) const;
+
+        // Выводит только объекты с индексами object_indices (по возрастанию) в документ
+        // с областью просмотра view_box
+        void Render(io::OutputBuffer& out, const std::vector<uint32_t>& object_indices, const Rect& view_box) const;
+
+        size_t GetObjectCount() const {
+            return objects_.size();
+        }
+
+        // Передаёт visitor индекс объекта и его габариты с учётом толщины линии.
+        // Ломаная передаётся по отрезкам, размер текста оценивается по размеру шрифта.
+        // Для объектов неизвестного вида габариты не вызываются: они видны в любой области
+        void VisitBounds(const std::function<void(uint32_t, const Rect&)>& visitor) const;
+
+        // Индексы объектов, габариты которых неизвестны
+        std::vector<uint32_t> GetUnboundedObjects() const;
+
     private:
-        std::vector<std::unique_ptr<Object>> objects_;
+        enum class ObjectKind : uint8_t {
+            CIRCLE,
+            POLYLINE,
+            TEXT,
+            OTHER,
+        };
+
+        // Ссылка на запись объекта в массиве соответствующего вида; задаёт порядок вывода
+        struct ObjectRef {
+            ObjectKind kind;
+            uint32_t index;
+        };
+
+        struct CircleRecord {
+            Point center;
+            double radius;
+            uint32_t style;
+        };
+
+        struct PolylineRecord {
+            uint32_t style;
+            uint32_t first_point;
+            uint32_t point_count;
+        };
+
+        struct TextRecord {
+            Point position;
+            Point offset;
+            uint32_t font_size;
+            uint32_t style;
+            uint32_t font_family;
+            uint32_t font_weight;
+            uint32_t data_offset;
+            uint32_t data_size;
+        };
+
+        std::vector<ObjectRef> objects_;
+        std::vector<CircleRecord> circles_;
+        std::vector<PolylineRecord> polylines_;
+        std::vector<TextRecord> texts_;
+        std::vector<std::unique_ptr<Object>> other_objects_;
+
+        std::vector<Point> points_;
+        std::string text_data_;
+
+        std::vector<PathStyle> styles_;
+        std::unordered_map<PathStyle, uint32_t, detail::PathStyleHasher> style_ids_;
+        std::vector<std::string> strings_;
+        std::unordered_map<std::string, uint32_t> string_ids_;
+
+        std::string_view GetTextData(const TextRecord& text) const;
+
+        void RenderObject(const ObjectRef& object, const RenderContext& context) const;
+
+        void RenderObjects(io::OutputBuffer& out) const;
     };
 }
@@ -0,0 +1,173 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+#include "trace.h"
+
+namespace threading {
+    namespace {
+        // Пул и номер потока, в котором выполняется текущий код; nullptr вне потоков пулов
+        thread_local const ThreadPool* current_pool = nullptr;
+        thread_local size_t current_worker = 0;
+    }
+
+    ThreadPool::ThreadPool(size_t thread_count) {
+        queues_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i) {
+            queues_.push_back(std::make_unique<WorkerQueue>());
+        }
+        workers_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers_.emplace_back([this, i] {
+                current_pool = this;
+                current_worker = i;
+                tracing::SetThreadName("pool worker " + std::to_string(i));
+                WorkerLoop(i);
+            });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        has_tasks_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    bool ThreadPool::IsCurrentThreadWorker() const {
+        return current_pool == this;
+    }
+
+    void ThreadPool::Push(std::function<void()> task) {
+        const size_t queue_index = current_pool == this
+                                   ? current_worker
+                                   : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        {
+            WorkerQueue& queue = *queues_[queue_index];
+            std::lock_guard lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard lock(mutex_);
+            ++queued_tasks_;
+        }
+        has_tasks_.notify_one();
+    }
+
+    bool ThreadPool::TryPop(size_t worker_index, std::function<void()>& task) {
+        for (size_t offset = 0; offset < queues_.size(); ++offset) {
+            WorkerQueue& queue = *queues_[(worker_index + offset) % queues_.size()];
+            std::lock_guard lock(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (offset == 0) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            else {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            --queued_tasks_;
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::WorkerLoop(size_t worker_index) {
+        while (true) {
+            std::function<void()> task;
+            if (TryPop(worker_index, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock lock(mutex_);
+            has_tasks_.wait(lock, [this] {
+                return stopping_ || queued_tasks_ > 0;
+            });
+            if (stopping_ && queued_tasks_ <= 0) {
+                return;
+            }
+        }
+    }
+
+    size_t GetHardwareConcurrency() {
+        // Переменная окружения TC_THREADS позволяет ограничить или задать число потоков явно
+        static const size_t concurrency = [] {
+            if (const char* threads = std::getenv("TC_THREADS"); threads != nullptr && std::atoi(threads) > 0) {
+                return static_cast<size_t>(std::atoi(threads));
+            }
+            const unsigned hardware_concurrency = std::thread::hardware_concurrency();
+            return hardware_concurrency == 0 ? size_t{1} : size_t{hardware_concurrency};
+        }();
+        return concurrency;
+    }
+
+    ThreadPool& GetSharedPool() {
+        static ThreadPool pool(GetHardwareConcurrency());
+        return pool;
+    }
+
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+        if (count <= 1 || GetHardwareConcurrency() <= 1) {
+            for (size_t i = 0; i < count; ++i) {
+                body(i);
+            }
+            return;
+        }
+
+        // Состояние живёт, пока его держат задачи пула: опоздавшая задача не найдёт
+        // свободных индексов и завершится, не обращаясь к body
+        struct State {
+            std::atomic<size_t> next_index = 0;
+            std::mutex mutex;
+            std::condition_variable finished;
+            size_t finished_count = 0;
+            std::exception_ptr error;
+        };
+        auto state = std::make_shared<State>();
+
+        auto work = [state, &body, count] {
+            for (size_t i = state->next_index.fetch_add(1); i < count; i = state->next_index.fetch_add(1)) {
+                std::exception_ptr error;
+                try {
+                    body(i);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard lock(state->mutex);
+                if (error && !state->error) {
+                    state->error = error;
+                }
+                if (++state->finished_count == count) {
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        ThreadPool& pool = GetSharedPool();
+        const size_t helpers = std::min(pool.GetThreadCount(), count - 1);
+        for (size_t i = 0; i < helpers; ++i) {
+            pool.Submit(work);
+        }
+        work();
+
+        std::unique_lock lock(state->mutex);
+        state->finished.wait(lock, [&] {
+            return state->finished_count == count;
+        });
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+}
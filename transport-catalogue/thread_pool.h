@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "memory_accounting.h"
+
+namespace threading {
+    /*
+     * Пул потоков фиксированного размера. У каждого потока своя очередь задач:
+     * задача, поставленная из потока пула, попадает в его очередь, остальные
+     * распределяются по очередям по кругу. Поток берёт задачи из начала своей
+     * очереди, а опустев, забирает задачи с конца чужих.
+     * Submit возвращает std::future с результатом задачи; исключение,
+     * выброшенное задачей, передаётся через future. Выделения памяти задачи
+     * относятся к подсистеме, заданной в потоке, который её поставил.
+     */
+    class ThreadPool {
+    public:
+        explicit ThreadPool(size_t thread_count);
+
+        ThreadPool(const ThreadPool&) = delete;
+
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool();
+
+        size_t GetThreadCount() const {
+            return workers_.size();
+        }
+
+        // Выполняется ли вызывающий код в одном из потоков этого пула
+        bool IsCurrentThreadWorker() const;
+
+        template <typename Task>
+        auto Submit(Task task) -> std::future<std::invoke_result_t<Task>> {
+            using Result = std::invoke_result_t<Task>;
+            auto packaged_task = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+            std::future<Result> result = packaged_task->get_future();
+            Push([packaged_task, subsystem = memory::GetCurrentSubsystem()] {
+                memory::ScopedSubsystem scoped_subsystem(subsystem);
+                (*packaged_task)();
+            });
+            return result;
+        }
+
+    private:
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues_;
+        std::vector<std::thread> workers_;
+        std::atomic<size_t> next_queue_ = 0;
+
+        // queued_tasks_ увеличивается под mutex_, чтобы уснувший поток не пропустил новую задачу.
+        // Уменьшается без блокировки и может ненадолго уйти в минус, пока задачу уже забрали,
+        // а Push ещё не учёл её
+        std::mutex mutex_;
+        std::condition_variable has_tasks_;
+        std::atomic<int64_t> queued_tasks_ = 0;
+        bool stopping_ = false;
+
+        void Push(std::function<void()> task);
+
+        bool TryPop(size_t worker_index, std::function<void()>& task);
+
+        void WorkerLoop(size_t worker_index);
+    };
+
+    // Число аппаратных потоков, но не меньше одного. Переопределяется переменной окружения TC_THREADS
+    size_t GetHardwareConcurrency();
+
+    // Общий пул процесса. Создаётся при первом обращении с GetHardwareConcurrency() потоками
+    ThreadPool& GetSharedPool();
+
+    /*
+     * Вызывает body(i) для i от 0 до count - 1 на общем пуле. Вызывающий поток сам
+     * разбирает индексы вместе с потоками пула и ждёт только начатые вызовы, поэтому
+     * ParallelFor можно вызывать и из задачи пула. При одном аппаратном потоке всё
+     * выполняется последовательно. Первое исключение из body передаётся вызывающему.
+     * Выделения памяти в body относятся к подсистеме вызывающего потока
+     */
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+}
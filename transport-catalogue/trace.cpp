@@ -0,0 +1,143 @@
+#include "trace.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "json_writer.h"
+#include "output_buffer.h"
+
+namespace tracing {
+    using namespace std::literals;
+
+    namespace {
+        struct Event {
+            std::string_view name;
+            std::chrono::steady_clock::time_point start;
+            std::chrono::steady_clock::duration duration;
+        };
+
+        // Отрезки одного потока. Пишет в них только сам поток, блокировка нужна для вывода
+        struct ThreadTrace {
+            int id = 0;
+            std::mutex mutex;
+            std::string name;
+            std::vector<Event> events;
+        };
+
+        // Дорожки потоков. Они живут дольше потоков, поэтому отрезки завершившихся потоков
+        // попадают в вывод. Файл записывается из деструктора, то есть при завершении программы
+        class TraceRegistry {
+        public:
+            TraceRegistry() {
+                if (const char* destination = std::getenv("TC_TRACE");
+                    destination != nullptr && *destination != '\0') {
+                    destination_ = destination;
+                }
+            }
+
+            TraceRegistry(const TraceRegistry&) = delete;
+
+            TraceRegistry& operator=(const TraceRegistry&) = delete;
+
+            ~TraceRegistry() {
+                if (!destination_.empty()) {
+                    std::ofstream output(destination_);
+                    Write(output);
+                }
+            }
+
+            bool IsEnabled() const {
+                return !destination_.empty();
+            }
+
+            ThreadTrace& AddThread() {
+                std::lock_guard lock(mutex_);
+                threads_.push_back(std::make_unique<ThreadTrace>());
+                threads_.back()->id = static_cast<int>(threads_.size());
+                return *threads_.back();
+            }
+
+            void Write(std::ostream& output) {
+                std::lock_guard lock(mutex_);
+                io::OutputBuffer buffer(output);
+                json::Writer writer(buffer, json::Writer::Layout::COMPACT);
+                const auto to_microseconds = [](std::chrono::steady_clock::duration duration) {
+                    return std::chrono::duration<double, std::micro>(duration).count();
+                };
+
+                writer.StartDict().Key("displayTimeUnit"sv).Value("ms"sv).Key("traceEvents"sv).StartArray();
+                for (const auto& thread : threads_) {
+                    std::lock_guard thread_lock(thread->mutex);
+                    if (!thread->name.empty()) {
+                        writer.StartDict()
+                              .Key("args"sv).StartDict().Key("name"sv).Value(thread->name).EndDict()
+                              .Key("name"sv).Value("thread_name"sv)
+                              .Key("ph"sv).Value("M"sv)
+                              .Key("pid"sv).Value(1)
+                              .Key("tid"sv).Value(thread->id)
+                              .EndDict();
+                    }
+                    for (const Event& event : thread->events) {
+                        writer.StartDict()
+                              .Key("dur"sv).Value(to_microseconds(event.duration))
+                              .Key("name"sv).Value(event.name)
+                              .Key("ph"sv).Value("X"sv)
+                              .Key("pid"sv).Value(1)
+                              .Key("tid"sv).Value(thread->id)
+                              .Key("ts"sv).Value(to_microseconds(event.start - epoch_))
+                              .EndDict();
+                    }
+                }
+                writer.EndArray().EndDict();
+                buffer.Put('\n');
+                buffer.Flush();
+            }
+
+        private:
+            std::string destination_;
+            std::chrono::steady_clock::time_point epoch_ = std::chrono::steady_clock::now();
+            std::mutex mutex_;
+            std::vector<std::unique_ptr<ThreadTrace>> threads_;
+        };
+
+        TraceRegistry& GetRegistry() {
+            static TraceRegistry registry;
+            return registry;
+        }
+
+        ThreadTrace& GetThreadTrace() {
+            thread_local ThreadTrace* thread_trace = &GetRegistry().AddThread();
+            return *thread_trace;
+        }
+    }
+
+    bool IsEnabled() {
+        static const bool enabled = GetRegistry().IsEnabled();
+        return enabled;
+    }
+
+    void SetThreadName(std::string name) {
+        if (!IsEnabled()) {
+            return;
+        }
+        ThreadTrace& thread_trace = GetThreadTrace();
+        std::lock_guard lock(thread_trace.mutex);
+        thread_trace.name = std::move(name);
+    }
+
+    void WriteTrace(std::ostream& output) {
+        GetRegistry().Write(output);
+    }
+
+    void Span::Record(std::string_view name, std::chrono::steady_clock::time_point start,
+                      std::chrono::steady_clock::time_point end) {
+        ThreadTrace& thread_trace = GetThreadTrace();
+        std::lock_guard lock(thread_trace.mutex);
+        thread_trace.events.push_back({name, start, end - start});
+    }
+}
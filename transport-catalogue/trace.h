@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace tracing {
+    // Трассировка включается переменной окружения TC_TRACE с путём к файлу. При завершении программы
+    // в него записываются отрезки Span в формате Chrome trace event (chrome://tracing, Perfetto),
+    // у каждого потока - своя дорожка. Без TC_TRACE отрезок стоит одной проверки
+    bool IsEnabled();
+
+    // Подпись дорожки текущего потока; по умолчанию дорожки подписаны номерами потоков
+    void SetThreadName(std::string name);
+
+    // Выводит записанные к этому моменту отрезки
+    void WriteTrace(std::ostream& output);
+
+    // Отрезок от создания до разрушения объекта. name должен существовать до конца программы,
+    // обычно это строковый литерал
+    class Span {
+    public:
+        explicit Span(std::string_view name)
+            : name_(name), enabled_(IsEnabled()) {
+            if (enabled_) {
+                start_ = std::chrono::steady_clock::now();
+            }
+        }
+
+        Span(const Span&) = delete;
+
+        Span& operator=(const Span&) = delete;
+
+        ~Span() {
+            if (enabled_) {
+                Record(name_, start_, std::chrono::steady_clock::now());
+            }
+        }
+
+    private:
+        std::string_view name_;
+        bool enabled_;
+        std::chrono::steady_clock::time_point start_;
+
+        static void Record(std::string_view name, std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end);
+    };
+}
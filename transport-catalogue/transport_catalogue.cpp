@@ -6,12 +6,15 @@ namespace transport {
     void Catalogue::SetDistance(std::string_view from_stop, std::string_view to_stop, int distance) {
         std::pair<const Stop * const, const Stop * const> from_to_pair(&GetStop(from_stop), &GetStop(to_stop));
         distances_.emplace(from_to_pair, distance);
+        ++version_;
     }
 
     void Catalogue::AddStop(Stop&& stop) {
+        stop.index = stops_.size();
         stops_.push_back(std::make_shared<Stop>(std::move(stop)));
         std::weak_ptr added_stop = stops_.back();
         stopnames_to_stops_[added_stop.lock()->name] = std::move(added_stop);
+        ++version_;
     }
 
     bool Catalogue::HasStop(std::string_view stop_name) const {
@@ -33,6 +36,7 @@ namespace transport {
             stop.lock()->passing_busses.emplace(added_bus.lock().get());
         }
         busnumber_to_bus_[added_bus.lock()->number] = std::move(added_bus);
+        ++version_;
     }
 
     bool Catalogue::HasBus(const std::string_view bus_number) const {
@@ -81,4 +85,12 @@ namespace transport {
     const std::vector<std::shared_ptr<Bus>>& Catalogue::GetAllBusses() const {
         return busses_;
     }
+
+    size_t Catalogue::GetDistanceCount() const {
+        return distances_.size();
+    }
+
+    uint64_t Catalogue::GetVersion() const {
+        return version_;
+    }
 }
@@ -3,6 +3,7 @@
 #include <vector>
 #include <optional>
 #include <algorithm>
+#include <cstdint>
 
 #include "domain.h"
 
@@ -31,10 +32,19 @@ namespace transport {
 
         const std::vector<std::shared_ptr<Bus>>& GetAllBusses() const;
 
+        // Число заданных расстояний между парами остановок
+        size_t GetDistanceCount() const;
+
         template <typename IterType>
         std::optional<int> GetDistanceBetweenStopsOnOneRoute(IterType from_stop, IterType to_stop, const Bus& bus) const;
 
+        // Номер версии справочника. Увеличивается при каждом изменении остановок, маршрутов или расстояний,
+        // чтобы построенные по справочнику данные (карта, кэши) могли понять, что устарели
+        uint64_t GetVersion() const;
+
     private:
+        uint64_t version_ = 0;
+
         std::vector<std::shared_ptr<Stop>> stops_;
         std::unordered_map<std::string_view, std::weak_ptr<Stop>> stopnames_to_stops_;
 
@@ -1,5 +1,7 @@
 #include "transport_router.h"
 
+#include "trace.h"
+
 namespace transport {
     Router::Router(const Catalogue& catalogue, const RouterSettings& settings)
         : settings_(settings),
@@ -10,7 +12,12 @@ namespace transport {
     }
 
     void Router::BuildGraph() {
-        AddRoutesToGraph();
+        using namespace std::literals;
+        {
+            tracing::Span span("transport::Router::AddRoutesToGraph"sv);
+            AddRoutesToGraph();
+        }
+        tracing::Span span("graph::Router"sv);
         router_ = std::make_unique<graph::Router<WeightType>>(graph_);
     }
 
@@ -44,6 +51,7 @@ namespace transport {
 
     std::optional<Route> Router::PlotRoute(const std::string_view from_stop,
                                            const std::string_view to_stop) const {
+        route_queries_.Add(1);
         const auto from_edge = GetStopEdge(from_stop);
         const auto to_edge = GetStopEdge(to_stop);
         if (from_edge.has_value() && to_edge.has_value()) {
@@ -51,12 +59,18 @@ namespace transport {
             const graph::VertexId to_id = to_edge.value().get().from;
             const std::optional<graph::Router<double>::RouteInfo> route_info = router_->BuildRoute(from_id, to_id);
             if (route_info.has_value()) {
+                route_edges_.Add(route_info->edges.size());
                 return GenerateRouteInformation(route_info.value());
             }
         }
         return std::nullopt;
     }
 
+    Router::Stats Router::GetStats() const {
+        return {graph_.GetVertexCount(), graph_.GetEdgeCount(), router_->GetRoutesTableBytes(),
+                router_->GetRelaxationCount(), route_queries_.Get(), route_edges_.Get()};
+    }
+
     std::optional<std::reference_wrapper<const graph::Edge<double>>> Router::GetStopEdge(
         const std::string_view stop_name) const {
         if (const auto edge = stopname_to_stop_edgeid_.find(stop_name); edge != stopname_to_stop_edgeid_.end()) {
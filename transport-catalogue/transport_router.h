@@ -3,6 +3,7 @@
 
 #include "domain.h"
 #include "router.h"
+#include "sharded_counter.h"
 #include "transport_catalogue.h"
 
 namespace transport {
@@ -37,6 +38,19 @@ namespace transport {
         std::optional<Route> PlotRoute(std::string_view from_stop,
                                        std::string_view to_stop) const;
 
+        // relaxation_count - улучшения путей при построении таблицы маршрутов;
+        // route_queries и route_edges - вызовы PlotRoute и рёбра в найденных маршрутах
+        struct Stats {
+            size_t vertex_count = 0;
+            size_t edge_count = 0;
+            size_t routes_table_bytes = 0;
+            size_t relaxation_count = 0;
+            uint64_t route_queries = 0;
+            uint64_t route_edges = 0;
+        };
+
+        Stats GetStats() const;
+
     private:
         RouterSettings settings_;
         const Catalogue& catalogue_;
@@ -52,6 +66,9 @@ namespace transport {
         };
         std::unordered_map<graph::EdgeId, EdgeInfo> edgeid_to_edgeinfo_;
 
+        mutable metrics::ShardedCounter route_queries_;
+        mutable metrics::ShardedCounter route_edges_;
+
         void BuildGraph();
 
         [[nodiscard]]